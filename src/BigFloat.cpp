@@ -0,0 +1,283 @@
+#include "BigFloat.h"
+
+#include <cmath>
+#include <cstdlib>
+
+using namespace std;
+
+bigFloat::bigFloat()
+{
+	words = 1;
+	negative = false;
+	for(int i = 0; i < maxWords; i++)
+		digits[i] = 0;
+}
+
+bigFloat::bigFloat(double value, int precision)
+{
+	words = precision < 1 ? 1 : (precision > maxWords ? maxWords : precision);
+	negative = value < 0.0;
+	for(int i = 0; i < maxWords; i++)
+		digits[i] = 0;
+
+	// a double has 53 significant bits, so this ends after a few words
+	double magnitude = fabs(value);
+	double whole = floor(magnitude);
+	digits[0] = (uint32_t)whole;
+	magnitude -= whole;
+	for(int i = 1; i < words && magnitude != 0.0; i++)
+	{
+		magnitude = ldexp(magnitude, 32);
+		whole = floor(magnitude);
+		digits[i] = (uint32_t)whole;
+		magnitude -= whole;
+	}
+	if(isZero())
+		negative = false;
+}
+
+void bigFloat::setPrecision(int precision)
+{
+	precision = precision < 1 ? 1 : (precision > maxWords ? maxWords : precision);
+	for(int i = precision; i < maxWords; i++)
+		digits[i] = 0;
+	words = precision;
+	if(isZero())
+		negative = false;
+}
+
+double bigFloat::toDouble() const
+{
+	double value = 0.0;
+	for(int i = words - 1; i >= 0; i--)
+		value += ldexp((double)digits[i], -32 * i);
+	return negative ? -value : value;
+}
+
+string bigFloat::toString(int decimals) const
+{
+	string text = negative ? "-" : "";
+
+	char integer[16];
+	int length = 0;
+	uint32_t whole = digits[0];
+	do
+	{
+		integer[length++] = char('0' + whole % 10);
+		whole /= 10;
+	} while(whole != 0);
+	while(length > 0)
+		text += integer[--length];
+
+	bigFloat fraction = *this;
+	fraction.digits[0] = 0;
+	if(decimals > 0)
+		text += '.';
+	for(int i = 0; i < decimals; i++)
+	{
+		fraction.multiplySmall(10);
+		text += char('0' + fraction.digits[0]);
+		fraction.digits[0] = 0;
+	}
+	return text;
+}
+
+bool bigFloat::parse(const string& text, int precision, bigFloat& value)
+{
+	size_t position = 0;
+	bool negative = false;
+	if(position < text.size() && (text[position] == '-' || text[position] == '+'))
+		negative = text[position++] == '-';
+
+	uint64_t whole = 0;
+	size_t integerDigits = 0;
+	while(position < text.size() && text[position] >= '0' && text[position] <= '9')
+	{
+		whole = whole * 10 + (text[position++] - '0');
+		if(whole > 0xffffffffu)
+			return false;
+		++integerDigits;
+	}
+
+	string fractionDigits;
+	if(position < text.size() && text[position] == '.')
+	{
+		++position;
+		while(position < text.size() && text[position] >= '0' && text[position] <= '9')
+			fractionDigits += text[position++];
+	}
+	if(integerDigits == 0 && fractionDigits.empty())
+		return false;
+
+	int exponent = 0;
+	if(position < text.size() && (text[position] == 'e' || text[position] == 'E'))
+	{
+		++position;
+		char* end;
+		long parsed = strtol(text.c_str() + position, &end, 10);
+		if(end == text.c_str() + position || parsed < -400 || parsed > 400)
+			return false;
+		exponent = (int)parsed;
+		position = end - text.c_str();
+	}
+	if(position != text.size())
+		return false;
+
+	// a guard word keeps the divisions by ten from eating into the last digit
+	bigFloat result(0.0, precision + 1);
+	for(size_t i = fractionDigits.size(); i > 0; i--)
+	{
+		result.digits[0] += fractionDigits[i - 1] - '0';
+		result.divideSmall(10);
+	}
+	result.digits[0] = (uint32_t)whole;
+
+	for(; exponent > 0; exponent--)
+	{
+		if(result.digits[0] >= 0xffffffffu / 10)
+			return false;
+		result.multiplySmall(10);
+	}
+	for(; exponent < 0; exponent++)
+		result.divideSmall(10);
+
+	result.negative = negative;
+	result.setPrecision(precision);
+	value = result;
+	return true;
+}
+
+int bigFloat::wordsFor(double spacing)
+{
+	if(!(spacing > 0.0))
+		return maxWords;
+	int bits = (int)ceil(-log2(spacing)) + 64;
+	int words = 1 + (bits + 31) / 32;
+	return words < 3 ? 3 : (words > maxWords ? maxWords : words);
+}
+
+bool bigFloat::isZero() const
+{
+	for(int i = 0; i < words; i++)
+		if(digits[i] != 0)
+			return false;
+	return true;
+}
+
+int bigFloat::compareMagnitude(const bigFloat& a, const bigFloat& b)
+{
+	// words past a value's precision are always zero
+	int words = a.words > b.words ? a.words : b.words;
+	for(int i = 0; i < words; i++)
+	{
+		if(a.digits[i] != b.digits[i])
+			return a.digits[i] < b.digits[i] ? -1 : 1;
+	}
+	return 0;
+}
+
+bigFloat bigFloat::addMagnitudes(const bigFloat& a, const bigFloat& b, bool negative)
+{
+	bigFloat sum;
+	sum.words = a.words > b.words ? a.words : b.words;
+	uint64_t carry = 0;
+	for(int i = sum.words - 1; i >= 0; i--)
+	{
+		carry += (uint64_t)a.digits[i] + b.digits[i];
+		sum.digits[i] = (uint32_t)carry;
+		carry >>= 32;
+	}
+	sum.negative = negative && !sum.isZero();
+	return sum;
+}
+
+bigFloat bigFloat::subtractMagnitudes(const bigFloat& larger, const bigFloat& smaller, bool negative)
+{
+	bigFloat difference;
+	difference.words = larger.words > smaller.words ? larger.words : smaller.words;
+	int64_t borrow = 0;
+	for(int i = difference.words - 1; i >= 0; i--)
+	{
+		int64_t word = (int64_t)larger.digits[i] - smaller.digits[i] - borrow;
+		borrow = word < 0 ? 1 : 0;
+		difference.digits[i] = (uint32_t)(word + (borrow << 32));
+	}
+	difference.negative = negative && !difference.isZero();
+	return difference;
+}
+
+bigFloat operator+(const bigFloat& a, const bigFloat& b)
+{
+	if(a.negative == b.negative)
+		return bigFloat::addMagnitudes(a, b, a.negative);
+	if(bigFloat::compareMagnitude(a, b) >= 0)
+		return bigFloat::subtractMagnitudes(a, b, a.negative);
+	return bigFloat::subtractMagnitudes(b, a, b.negative);
+}
+
+bigFloat operator-(const bigFloat& a, const bigFloat& b)
+{
+	return a + (-b);
+}
+
+bigFloat bigFloat::operator-() const
+{
+	bigFloat negated = *this;
+	negated.negative = !negative && !isZero();
+	return negated;
+}
+
+bigFloat operator*(const bigFloat& a, const bigFloat& b)
+{
+	const int words = a.words > b.words ? a.words : b.words;
+
+	// column i + j collects the low half of digit i times digit j and column
+	// i + j - 1 the high half; one extra column is kept for the carries
+	uint64_t columns[bigFloat::maxWords + 1] = {0};
+	for(int i = 0; i < words; i++)
+	{
+		if(a.digits[i] == 0)
+			continue;
+		for(int j = 0; i + j <= words && j < words; j++)
+		{
+			uint64_t product = (uint64_t)a.digits[i] * b.digits[j];
+			columns[i + j] += product & 0xffffffffu;
+			if(i + j > 0)
+				columns[i + j - 1] += product >> 32;
+		}
+	}
+	for(int i = words; i > 0; i--)
+	{
+		columns[i - 1] += columns[i] >> 32;
+		columns[i] &= 0xffffffffu;
+	}
+
+	bigFloat product;
+	product.words = words;
+	for(int i = 0; i < words; i++)
+		product.digits[i] = (uint32_t)columns[i];
+	product.negative = a.negative != b.negative && !product.isZero();
+	return product;
+}
+
+void bigFloat::multiplySmall(uint32_t factor)
+{
+	uint64_t carry = 0;
+	for(int i = words - 1; i >= 0; i--)
+	{
+		carry += (uint64_t)digits[i] * factor;
+		digits[i] = (uint32_t)carry;
+		carry >>= 32;
+	}
+}
+
+void bigFloat::divideSmall(uint32_t divisor)
+{
+	uint64_t remainder = 0;
+	for(int i = 0; i < words; i++)
+	{
+		uint64_t current = (remainder << 32) | digits[i];
+		digits[i] = (uint32_t)(current / divisor);
+		remainder = current % divisor;
+	}
+}
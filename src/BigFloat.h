@@ -0,0 +1,53 @@
+// BigFloat.h
+// Fixed-point number with a selectable number of 32-bit words, for the
+// reference orbits of deep zooms (DeepZoom.h). Word 0 holds the integer part,
+// the others hold fractions of 2^-32, 2^-64, ..., and the sign is kept apart.
+// Only the operations an escape-time orbit needs are provided; results are
+// truncated to the larger precision of the operands.
+
+#pragma once
+
+#include <stdint.h>
+#include <string>
+
+class bigFloat
+{
+public:
+	static const int maxWords = 48;
+
+	bigFloat();
+	bigFloat(double value, int words);
+
+	int precision() const { return words; }
+	// Extends or truncates the fraction to the given number of words
+	void setPrecision(int words);
+
+	double toDouble() const;
+	// Decimal representation with the given number of fraction digits
+	std::string toString(int digits) const;
+
+	// Parses "[-]digits[.digits][e[-]digits]"; returns false on anything else.
+	// Unlike atof this keeps every digit that fits in words.
+	static bool parse(const std::string& text, int words, bigFloat& value);
+
+	// Words needed so that steps of size spacing still differ in the last
+	// 64 bits, i.e. enough to iterate a reference orbit for that pixel size
+	static int wordsFor(double spacing);
+
+	friend bigFloat operator+(const bigFloat& a, const bigFloat& b);
+	friend bigFloat operator-(const bigFloat& a, const bigFloat& b);
+	friend bigFloat operator*(const bigFloat& a, const bigFloat& b);
+	bigFloat operator-() const;
+
+private:
+	uint32_t digits[maxWords];
+	int words;
+	bool negative;
+
+	bool isZero() const;
+	static int compareMagnitude(const bigFloat& a, const bigFloat& b);
+	static bigFloat addMagnitudes(const bigFloat& a, const bigFloat& b, bool negative);
+	static bigFloat subtractMagnitudes(const bigFloat& larger, const bigFloat& smaller, bool negative);
+	void multiplySmall(uint32_t factor);
+	void divideSmall(uint32_t divisor);
+};
@@ -0,0 +1,97 @@
+#include "CpuFeatures.h"
+
+#if defined(_MSC_VER)
+#  include <intrin.h>
+#elif defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__))
+#  include <cpuid.h>
+#endif
+
+using namespace std;
+
+const string instructionSetArray[4] = {"scalar", "SSE2", "AVX2", "AVX-512"};
+
+#if defined(_MSC_VER) || (defined(__GNUC__) && (defined(__x86_64__) || defined(__i386__)))
+
+static void cpuid(unsigned int leaf, unsigned int subleaf, unsigned int registers[4])
+{
+#if defined(_MSC_VER)
+	int values[4];
+	__cpuidex(values, (int)leaf, (int)subleaf);
+	for(int i = 0; i < 4; i++)
+		registers[i] = (unsigned int)values[i];
+#else
+	__cpuid_count(leaf, subleaf, registers[0], registers[1], registers[2], registers[3]);
+#endif
+}
+
+// Which register states the OS saves on a context switch (XCR0)
+static unsigned long long enabledStates()
+{
+#if defined(_MSC_VER)
+	return _xgetbv(0);
+#else
+	unsigned int low;
+	unsigned int high;
+	__asm__ __volatile__("xgetbv" : "=a"(low), "=d"(high) : "c"(0));
+	return ((unsigned long long)high << 32) | low;
+#endif
+}
+
+instructionSet detectInstructionSet()
+{
+	unsigned int registers[4];
+
+	cpuid(0, 0, registers);
+	unsigned int highestLeaf = registers[0];
+	if(highestLeaf < 1)
+		return Scalar;
+
+	cpuid(1, 0, registers);
+	bool sse2 = (registers[3] & (1u << 26)) != 0;
+	bool osxsave = (registers[2] & (1u << 27)) != 0;
+	bool avx = (registers[2] & (1u << 28)) != 0;
+	if(!sse2)
+		return Scalar;
+	if(!osxsave || !avx || highestLeaf < 7)
+		return SSE2;
+
+	unsigned long long states = enabledStates();
+	// XMM and YMM state
+	if((states & 0x6) != 0x6)
+		return SSE2;
+
+	cpuid(7, 0, registers);
+	bool avx2 = (registers[1] & (1u << 5)) != 0;
+	bool avx512f = (registers[1] & (1u << 16)) != 0;
+	if(!avx2)
+		return SSE2;
+
+	// opmask, upper ZMM0-15 and ZMM16-31 state
+	if(avx512f && (states & 0xe0) == 0xe0)
+		return AVX512;
+	return AVX2;
+}
+
+#else
+
+instructionSet detectInstructionSet()
+{
+	return Scalar;
+}
+
+#endif
+
+bool parseInstructionSet(const string& name, instructionSet& isa)
+{
+	if(name == "scalar")
+		isa = Scalar;
+	else if(name == "sse2")
+		isa = SSE2;
+	else if(name == "avx2")
+		isa = AVX2;
+	else if(name == "avx512")
+		isa = AVX512;
+	else
+		return false;
+	return true;
+}
@@ -0,0 +1,18 @@
+// CpuFeatures.h
+// Runtime detection of the vector instruction sets the escape kernels can use,
+// so a single binary picks the widest one each machine supports.
+
+#pragma once
+
+#include <string>
+
+// Ordered from narrowest to widest
+enum instructionSet{Scalar, SSE2, AVX2, AVX512};
+
+extern const std::string instructionSetArray[4];
+
+// Widest instruction set supported by both the CPU and the operating system
+instructionSet detectInstructionSet();
+
+// Parses "scalar", "sse2", "avx2" or "avx512"; returns false for anything else
+bool parseInstructionSet(const std::string& name, instructionSet& isa);
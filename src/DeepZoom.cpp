@@ -0,0 +1,316 @@
+#include "FloatContraction.h"
+#include "DeepZoom.h"
+#include "FractalPolicies.h"
+#include "PointRenderer.h"
+
+#include <algorithm>
+#include <cfloat>
+#include <cmath>
+
+using namespace std;
+
+namespace {
+
+// True if |a| < |b|. Offsets below about 1e-154 have squares that underflow,
+// so those are compared scaled up by 2^600; an a that overflows then is
+// rightly the larger.
+inline bool closer(double aRe, double aIm, double bRe, double bIm)
+{
+	static const double tiny = 1.0e-150;
+	static const double scaleUp = ldexp(1.0, 600);
+	if(fabs(bRe) + fabs(bIm) < tiny)
+	{
+		aRe *= scaleUp;
+		aIm *= scaleUp;
+		bRe *= scaleUp;
+		bIm *= scaleUp;
+	}
+	return aRe * aRe + aIm * aIm < bRe * bRe + bIm * bIm;
+}
+
+// Iterates pixel offsets against formula's reference orbit, one pixel at a time
+struct perturbationLoop
+{
+	typedef double real;
+
+	template<class formula>
+	static void run(const double* re, const double* im, int count, const orbitConstants& constants, int* iterations, laneStatistics* statistics)
+	{
+		const perturbationReference& reference = formula::reference(constants);
+		const double* orbitRe = &reference.orbitRe[0];
+		const double* orbitIm = &reference.orbitIm[0];
+		const int length = (int)reference.orbitRe.size();
+		unsigned long long steps = 0;
+
+		for(int i = 0; i < count; i++)
+		{
+			// radius ((c u + b) u + a) u
+			double uRe = re[i] / reference.radius;
+			double uIm = im[i] / reference.radius;
+			double dzRe = reference.seriesRe[2];
+			double dzIm = reference.seriesIm[2];
+			for(int term = 1; term >= -1; term--)
+			{
+				double productRe = dzRe * uRe - dzIm * uIm;
+				double productIm = dzRe * uIm + dzIm * uRe;
+				dzRe = productRe + (term >= 0 ? reference.seriesRe[term] : 0.0);
+				dzIm = productIm + (term >= 0 ? reference.seriesIm[term] : 0.0);
+			}
+			dzRe *= reference.radius;
+			dzIm *= reference.radius;
+
+			int m = reference.skipped;
+			int n = reference.skipped;
+			for(; n < constants.maxIterations; n++)
+			{
+				double zRe = orbitRe[m] + dzRe;
+				double zIm = orbitIm[m] + dzIm;
+				if(!(zRe * zRe + zIm * zIm <= 4.0))
+					break;
+
+				double startRe = zRe - orbitRe[0];
+				double startIm = zIm - orbitIm[0];
+				if(m + 1 >= length || closer(startRe, startIm, dzRe, dzIm))
+				{
+					dzRe = startRe;
+					dzIm = startIm;
+					m = 0;
+				}
+
+				double nextRe = 2.0 * (orbitRe[m] * dzRe - orbitIm[m] * dzIm) + (dzRe * dzRe - dzIm * dzIm);
+				double nextIm = 2.0 * (orbitRe[m] * dzIm + orbitIm[m] * dzRe) + 2.0 * dzRe * dzIm;
+				if(formula::addsPixel)
+				{
+					nextRe += re[i];
+					nextIm += im[i];
+				}
+				dzRe = nextRe;
+				dzIm = nextIm;
+				++m;
+			}
+			iterations[i] = n;
+			steps += n - reference.skipped;
+		}
+
+		if(statistics != NULL)
+		{
+			statistics->usedLanes += steps;
+			statistics->totalLanes += steps;
+		}
+	}
+
+	// the two formulas follow different reference orbits, so they run apart
+	template<class firstFormula, class secondFormula>
+	static void runPair(const double* re, const double* im, int count, const orbitConstants& constants, int* firstIterations, int* secondIterations, laneStatistics* statistics)
+	{
+		run<firstFormula>(re, im, count, constants, firstIterations, statistics);
+		run<secondFormula>(re, im, count, constants, secondIterations, statistics);
+	}
+};
+
+struct deepRendererTable
+{
+	pointRenderer renderers[4];
+
+	deepRendererTable()
+	{
+		fillFractals<perturbationLoop>(renderers);
+	}
+};
+
+}
+
+// Z_0 .. Z_n until the orbit escapes or reaches maxIterations, always at
+// least two points so the pixels have a step to rebase onto
+static void computeOrbit(perturbationReference& reference, bool mandelbrot, const deepView& view, complex<double> juliaConstant, int maxIterations, int words)
+{
+	bigFloat zRe(0.0, words);
+	bigFloat zIm(0.0, words);
+	bigFloat cRe = view.centerX;
+	bigFloat cIm = view.centerY;
+	cRe.setPrecision(words);
+	cIm.setPrecision(words);
+	if(!mandelbrot)
+	{
+		zRe = cRe;
+		zIm = cIm;
+		cRe = bigFloat(juliaConstant.real(), words);
+		cIm = bigFloat(juliaConstant.imag(), words);
+	}
+
+	reference.orbitRe.clear();
+	reference.orbitIm.clear();
+	for(int n = 0; n <= maxIterations; n++)
+	{
+		double re = zRe.toDouble();
+		double im = zIm.toDouble();
+		reference.orbitRe.push_back(re);
+		reference.orbitIm.push_back(im);
+		if(!(re * re + im * im <= 4.0) && n >= 1)
+			break;
+
+		bigFloat reIm = zRe * zIm;
+		zRe = zRe * zRe - zIm * zIm + cRe;
+		zIm = reIm + reIm + cIm;
+	}
+}
+
+// Runs the series alongside eight probe pixels on the view's border and keeps
+// the last coefficients whose prediction was within a billionth of a pixel
+// for all of them. Looser limits skip more, but the error then gets amplified
+// along with everything else on pixels near the boundary of the set.
+//
+// Everything is in units of radius, so nothing underflows however deep the
+// view: a starts near 1, and b and c, which start at radius and radius^2
+// times a^2 and a^3, only round to 0 while they are too small to matter.
+static void approximateSeries(perturbationReference& reference, bool mandelbrot, const deepView& view, int maxIterations)
+{
+	const double radius = view.scale * sqrt(2.0);
+	// the pixel spacing in units of radius
+	const double spacing = 1.0 / (view.width / 2.0 * sqrt(2.0));
+	const int probeCount = 8;
+	const double edge = 1.0 / sqrt(2.0);
+	const complex<double> probes[probeCount] = {
+		complex<double>(-edge, -edge), complex<double>(edge, -edge),
+		complex<double>(-edge, edge), complex<double>(edge, edge),
+		complex<double>(-edge, 0.0), complex<double>(edge, 0.0),
+		complex<double>(0.0, -edge), complex<double>(0.0, edge)};
+
+	complex<double> a = mandelbrot ? 0.0 : 1.0;
+	complex<double> b = 0.0;
+	complex<double> c = 0.0;
+	complex<double> offsets[probeCount];
+	for(int p = 0; p < probeCount; p++)
+		offsets[p] = mandelbrot ? 0.0 : probes[p];
+
+	reference.radius = radius;
+	reference.skipped = 0;
+	complex<double> kept[3] = {a, b, c};
+
+	const complex<double> start(reference.orbitRe[0], reference.orbitIm[0]);
+	const int length = (int)reference.orbitRe.size();
+	for(int n = 0; n + 1 < length && n < maxIterations; n++)
+	{
+		const complex<double> orbit(reference.orbitRe[n], reference.orbitIm[n]);
+		const double tolerance = 1.0e-9 * abs(a) * spacing;
+
+		bool valid = true;
+		for(int p = 0; p < probeCount && valid; p++)
+		{
+			const complex<double>& u = probes[p];
+			complex<double> predicted = ((c * u + b) * u + a) * u;
+			complex<double> z = orbit + offsets[p] * radius;
+			complex<double> fromStart = (z - start) / radius;
+			valid = abs(predicted - offsets[p]) <= tolerance && norm(z) <= 4.0 && !(norm(fromStart) < norm(offsets[p]));
+		}
+		if(!valid)
+			break;
+
+		reference.skipped = n;
+		kept[0] = a;
+		kept[1] = b;
+		kept[2] = c;
+
+		c = 2.0 * orbit * c + 2.0 * radius * a * b;
+		b = 2.0 * orbit * b + radius * a * a;
+		a = 2.0 * orbit * a + (mandelbrot ? 1.0 : 0.0);
+		for(int p = 0; p < probeCount; p++)
+			offsets[p] = 2.0 * orbit * offsets[p] + radius * offsets[p] * offsets[p] + (mandelbrot ? probes[p] : 0.0);
+	}
+
+	for(int term = 0; term < 3; term++)
+	{
+		reference.seriesRe[term] = kept[term].real();
+		reference.seriesIm[term] = kept[term].imag();
+	}
+}
+
+// Splits value into four doubles, largest first
+static void splitParts(const bigFloat& value, double* parts)
+{
+	bigFloat rest = value;
+	for(int i = 0; i < 4; i++)
+	{
+		parts[i] = rest.toDouble();
+		rest = rest - bigFloat(parts[i], rest.precision());
+	}
+}
+
+pointRenderer deepPointRenderer(const deepFrame& frame, fractalType fractal)
+{
+	static const deepRendererTable table;
+
+	if(frame.coordinates == DoubleCoordinates)
+		return selectPointRenderer(frame.isa, frame.mode, DoublePrecision, fractal);
+	if(frame.coordinates != PerturbationCoordinates)
+	{
+		precisionType precision = frame.coordinates == DoubleDoubleCoordinates ? DoubleDoublePrecision : QuadDoublePrecision;
+		return selectPointRenderer(frame.isa, frame.mode, precision, fractal);
+	}
+	return table.renderers[fractal];
+}
+
+void prepareDeepFrame(deepFrame& frame, const deepView& view, coordinateType coordinates, fractalType fractal, complex<double> juliaConstant, int maxIterations,
+	instructionSet isa, kernelMode mode)
+{
+	frame.coordinates = coordinates;
+	frame.referenceWords = 0;
+	frame.isa = isa;
+	frame.mode = mode;
+	splitParts(view.centerX, frame.center.re);
+	splitParts(view.centerY, frame.center.im);
+
+	viewport offsets = {0.0, 0.0, view.scale, view.width, view.height};
+	frame.grid = viewportGrid(offsets);
+
+	if(coordinates == DoubleCoordinates)
+	{
+		frame.grid.originRe = frame.center.re[0];
+		frame.grid.originIm = frame.center.im[0];
+	}
+	else if(coordinates == PerturbationCoordinates)
+	{
+		frame.referenceWords = bigFloat::wordsFor(view.scale / (view.width / 2.0));
+		if(fractal != Mandelbrot)
+		{
+			computeOrbit(frame.julia, false, view, juliaConstant, maxIterations, frame.referenceWords);
+			approximateSeries(frame.julia, false, view, maxIterations);
+		}
+		if(fractal != Julia)
+		{
+			computeOrbit(frame.mandelbrot, true, view, juliaConstant, maxIterations, frame.referenceWords);
+			approximateSeries(frame.mandelbrot, true, view, maxIterations);
+		}
+	}
+	frame.renderer = deepPointRenderer(frame, fractal);
+
+	frame.constants.juliaRe = juliaConstant.real();
+	frame.constants.juliaIm = juliaConstant.imag();
+	frame.constants.maxIterations = maxIterations;
+	frame.constants.center = &frame.center;
+	frame.constants.juliaReference = &frame.julia;
+	frame.constants.mandelbrotReference = &frame.mandelbrot;
+}
+
+bool resolvesPixels(double spacing, double epsilon)
+{
+	// orbits move around |z| <= 2, so rounding errors are relative to that
+	// rather than to the pixel's coordinates; keep them below a 64th of a pixel
+	return spacing >= 2.0 * epsilon * 64.0;
+}
+
+bool renderableSpacing(double spacing)
+{
+	return spacing >= DBL_MIN;
+}
+
+coordinateType coordinatesFor(double spacing)
+{
+	if(resolvesPixels(spacing, DBL_EPSILON))
+		return DoubleCoordinates;
+	// vectorized double-double keeps up with perturbation, but scalar
+	// quad-double is an order of magnitude slower, so it is never picked
+	if(resolvesPixels(spacing, DBL_EPSILON * DBL_EPSILON))
+		return DoubleDoubleCoordinates;
+	return PerturbationCoordinates;
+}
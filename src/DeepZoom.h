@@ -0,0 +1,95 @@
+// DeepZoom.h
+// Renderers for views too deep for double coordinates.
+//
+// Down to about 1e-30 pixels are iterated directly in double-double
+// (MultiDouble.h), as fast as perturbation but without its approximations.
+// Quad-double resolves them down to about 1e-60, but it is only used when
+// asked for. Deeper views use perturbation: only the orbit of the view center is iterated at full precision (bigFloat).
+// Every pixel then iterates its offset dz from that reference orbit Z in
+// double: dz -> 2 Z dz + dz^2 (+ the pixel's offset for Mandelbrot). The
+// offsets stay normal doubles as long as the pixel spacing is one (about
+// 1e-305 for scale at 500 pixels), so the image keeps its detail long after
+// the pixel coordinates themselves have run out of bits. Deeper views can't
+// be rendered; renderableSpacing() tells them apart.
+//
+// A cubic series in the pixel offset, checked against a few probe pixels on
+// the view's border, stands in for the first iterations that all pixels
+// share. When a pixel drifts closer to the start of the reference than to its
+// current point, or runs past the end of the reference, it is rebased onto
+// the start of the reference, which removes the usual perturbation glitches.
+
+#pragma once
+
+#include "BigFloat.h"
+#include "EscapeKernel.h"
+
+#include <complex>
+#include <vector>
+
+// Orbit of one formula at the view center, rounded to double, and the series
+// that puts every pixel skipped iterations along it
+struct perturbationReference
+{
+	std::vector<double> orbitRe;
+	std::vector<double> orbitIm;
+
+	// dz after skipped iterations is radius (a u + b u^2 + c u^3) with
+	// u = offset / radius, radius being the largest offset in the view. In
+	// units of radius the coefficients stay in range however deep the view is.
+	int skipped;
+	double radius;
+	double seriesRe[3];
+	double seriesIm[3];
+};
+
+// Like viewport, but with the center at the precision the zoom needs
+struct deepView
+{
+	bigFloat centerX;
+	bigFloat centerY;
+	double scale;
+	int width;
+	int height;
+};
+
+// constants points into the frame itself, so a deepFrame must not be copied
+struct deepFrame
+{
+	coordinateType coordinates;
+	// plane coordinates for double frames, offsets from the center otherwise
+	pixelGrid grid;
+	viewCenter center;
+	perturbationReference julia;
+	perturbationReference mandelbrot;
+	orbitConstants constants;
+	pointRenderer renderer;
+	int referenceWords;
+	// the vector kernels the renderers run on
+	instructionSet isa;
+	kernelMode mode;
+};
+
+// Sets up a frame rendered in the given coordinates: the center's parts, or
+// the reference orbits and series the fractal type needs, and the renderer.
+// Call once per frame; rendering then only reads the frame. frame.renderer
+// renders frame.grid with isa's kernels in the given mode (perturbation is
+// scalar on every instruction set).
+void prepareDeepFrame(deepFrame& frame, const deepView& view, coordinateType coordinates, fractalType fractal, std::complex<double> juliaConstant, int maxIterations,
+	instructionSet isa, kernelMode mode);
+
+// Renderer of frame's grid for a fractal type whose references the frame has:
+// the one it was prepared for, or the Julia or Mandelbrot layer of a Mixed or
+// Greater frame
+pointRenderer deepPointRenderer(const deepFrame& frame, fractalType fractal);
+
+// True if numbers with the given machine epsilon (FLT_EPSILON, DBL_EPSILON)
+// keep pixels spacing apart over many iterations
+bool resolvesPixels(double spacing, double epsilon);
+
+// True if pixels spacing apart can be rendered at all: their offsets from
+// the view center have to be normal doubles
+bool renderableSpacing(double spacing);
+
+// Cheapest coordinates that resolve pixels spacing apart: double, then
+// double-double, then perturbation
+coordinateType coordinatesFor(double spacing);
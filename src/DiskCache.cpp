@@ -0,0 +1,290 @@
+#include "DiskCache.h"
+
+#include <cstdio>
+#include <cstring>
+
+#if defined(_WIN32)
+#  define WIN32_LEAN_AND_MEAN
+#  include <windows.h>
+#  include <direct.h>
+#else
+#  include <fcntl.h>
+#  include <sys/mman.h>
+#  include <sys/stat.h>
+#  include <unistd.h>
+#endif
+
+using namespace std;
+
+// An entry file is this header, the key and then the counts, all in the
+// machine's byte order
+struct entryHeader
+{
+	char magic[8];
+	unsigned int keyLength;
+	unsigned int count;
+};
+
+static const char entryMagic[8] = {'F', 'R', 'C', 'O', 'U', 'N', 'T', '1'};
+
+// Read-only mapping of a whole file; data() is NULL if it couldn't be mapped
+class mappedFile
+{
+public:
+	explicit mappedFile(const string& path);
+	~mappedFile();
+
+	const unsigned char* data() const { return bytes; }
+	size_t size() const { return length; }
+
+private:
+	const unsigned char* bytes;
+	size_t length;
+#if defined(_WIN32)
+	HANDLE file;
+	HANDLE mapping;
+#endif
+
+	mappedFile(const mappedFile&);
+	mappedFile& operator=(const mappedFile&);
+};
+
+#if defined(_WIN32)
+
+mappedFile::mappedFile(const string& path) : bytes(NULL), length(0), mapping(NULL)
+{
+	file = CreateFileA(path.c_str(), GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	LARGE_INTEGER size;
+	if(file == INVALID_HANDLE_VALUE || !GetFileSizeEx(file, &size) || size.QuadPart == 0)
+		return;
+	mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+	if(mapping == NULL)
+		return;
+	bytes = (const unsigned char*)MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if(bytes != NULL)
+		length = (size_t)size.QuadPart;
+}
+
+mappedFile::~mappedFile()
+{
+	if(bytes != NULL)
+		UnmapViewOfFile(bytes);
+	if(mapping != NULL)
+		CloseHandle(mapping);
+	if(file != INVALID_HANDLE_VALUE)
+		CloseHandle(file);
+}
+
+static void makeDirectory(const string& path)
+{
+	_mkdir(path.c_str());
+}
+
+static bool replaceFile(const string& from, const string& to)
+{
+	return MoveFileExA(from.c_str(), to.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+}
+
+#else
+
+mappedFile::mappedFile(const string& path) : bytes(NULL), length(0)
+{
+	int file = open(path.c_str(), O_RDONLY);
+	if(file < 0)
+		return;
+	struct stat status;
+	if(fstat(file, &status) == 0 && status.st_size > 0)
+	{
+		void* view = mmap(NULL, (size_t)status.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+		if(view != MAP_FAILED)
+		{
+			bytes = (const unsigned char*)view;
+			length = (size_t)status.st_size;
+		}
+	}
+	// the mapping stays valid after the descriptor is closed
+	close(file);
+}
+
+mappedFile::~mappedFile()
+{
+	if(bytes != NULL)
+		munmap((void*)bytes, length);
+}
+
+static void makeDirectory(const string& path)
+{
+	mkdir(path.c_str(), 0777);
+}
+
+static bool replaceFile(const string& from, const string& to)
+{
+	return rename(from.c_str(), to.c_str()) == 0;
+}
+
+#endif
+
+// FNV-1a, as 16 hex digits
+static string hashName(const string& key)
+{
+	unsigned long long hash = 14695981039346656037ull;
+	for(size_t i = 0; i < key.size(); i++)
+	{
+		hash ^= (unsigned char)key[i];
+		hash *= 1099511628211ull;
+	}
+	char name[17];
+	snprintf(name, sizeof(name), "%016llx", hash);
+	return string(name) + ".counts";
+}
+
+// where files are written before replaceFile() moves them into place
+static string temporaryName(const string& name)
+{
+	return name + ".tmp";
+}
+
+diskCache::diskCache(const string& path, size_t bytes) : directory(path), budget(bytes), used(0), indexChanged(false)
+{
+	makeDirectory(directory);
+
+	FILE* fp = fopen(pathOf("index.txt").c_str(), "r");
+	if(fp == NULL)
+		return;
+	char name[64];
+	unsigned long long size;
+	while(fscanf(fp, "%63s %llu", name, &size) == 2)
+	{
+		entry stored = {name, (size_t)size};
+		entries.push_back(stored);
+		used += stored.size;
+	}
+	fclose(fp);
+}
+
+diskCache::~diskCache()
+{
+	if(indexChanged)
+		saveIndex();
+}
+
+bool diskCache::load(const string& key, int* counts, size_t count)
+{
+	const string name = hashName(key);
+	size_t index = 0;
+	while(index < entries.size() && entries[index].name != name)
+		++index;
+	if(index == entries.size())
+		return false;
+
+	const size_t headerSize = sizeof(entryHeader);
+	bool valid;
+	{
+		mappedFile file(pathOf(name));
+		entryHeader header;
+		valid = file.data() != NULL && file.size() == headerSize + key.size() + count * sizeof(int);
+		if(valid)
+		{
+			memcpy(&header, file.data(), headerSize);
+			valid = memcmp(header.magic, entryMagic, sizeof(entryMagic)) == 0 && header.keyLength == key.size()
+				&& header.count == count && memcmp(file.data() + headerSize, key.data(), key.size()) == 0;
+		}
+		if(valid)
+			memcpy(counts, file.data() + headerSize + key.size(), count * sizeof(int));
+	}
+
+	// a different key with the same hash, or a damaged file
+	if(!valid)
+	{
+		forget(index);
+		saveIndex();
+		return false;
+	}
+	touch(index);
+	return true;
+}
+
+bool diskCache::store(const string& key, const int* counts, size_t count)
+{
+	const string name = hashName(key);
+	for(size_t i = 0; i < entries.size(); i++)
+	{
+		if(entries[i].name == name)
+		{
+			forget(i);
+			break;
+		}
+	}
+
+	entryHeader header;
+	memcpy(header.magic, entryMagic, sizeof(entryMagic));
+	header.keyLength = (unsigned int)key.size();
+	header.count = (unsigned int)count;
+
+	const string written = pathOf(temporaryName(name));
+	FILE* fp = fopen(written.c_str(), "wb");
+	if(fp == NULL)
+	{
+		saveIndex();
+		return false;
+	}
+	bool complete = fwrite(&header, sizeof(header), 1, fp) == 1
+		&& fwrite(key.data(), 1, key.size(), fp) == key.size()
+		&& fwrite(counts, sizeof(int), count, fp) == count;
+	complete = fclose(fp) == 0 && complete;
+	if(!complete || !replaceFile(written, pathOf(name)))
+	{
+		remove(written.c_str());
+		saveIndex();
+		return false;
+	}
+
+	entry stored = {name, sizeof(header) + key.size() + count * sizeof(int)};
+	entries.push_back(stored);
+	used += stored.size;
+	// the entry just stored stays even if it alone is over the budget
+	while(used > budget && entries.size() > 1)
+		forget(0);
+	saveIndex();
+	return true;
+}
+
+string diskCache::pathOf(const string& name) const
+{
+	return directory + "/" + name;
+}
+
+// makes entries[index] the most recently used
+void diskCache::touch(size_t index)
+{
+	if(index + 1 == entries.size())
+		return;
+	entry recent = entries[index];
+	entries.erase(entries.begin() + index);
+	entries.push_back(recent);
+	indexChanged = true;
+}
+
+// deletes entries[index] and its file
+void diskCache::forget(size_t index)
+{
+	remove(pathOf(entries[index].name).c_str());
+	used -= entries[index].size;
+	entries.erase(entries.begin() + index);
+}
+
+void diskCache::saveIndex()
+{
+	const string written = pathOf(temporaryName("index.txt"));
+	FILE* fp = fopen(written.c_str(), "w");
+	if(fp == NULL)
+		return;
+	bool complete = true;
+	for(size_t i = 0; i < entries.size(); i++)
+		complete = fprintf(fp, "%s %llu\n", entries[i].name.c_str(), (unsigned long long)entries[i].size) > 0 && complete;
+	complete = fclose(fp) == 0 && complete;
+	if(complete && replaceFile(written, pathOf("index.txt")))
+		indexChanged = false;
+	else
+		remove(written.c_str());
+}
@@ -0,0 +1,59 @@
+// DiskCache.h
+// Iteration counts kept on disk between runs. An entry is one array of counts
+// stored under a key string that names everything the counts depend on; the
+// file is named after a hash of the key, so the same content always lands in
+// the same file. Entries are memory mapped when read, so a hit costs a copy
+// out of the page cache instead of iterating.
+//
+// The directory holds an index of the entries, least recently used first.
+// Storing an entry evicts the oldest ones until the total fits the budget.
+// Entry files and the index are written under a temporary name and renamed
+// into place, so a crash never leaves a torn file behind. Hits only reorder
+// the index in memory; it goes to disk with the next store or on destruction.
+// A diskCache is not thread safe; the viewer only uses it from its render
+// thread.
+
+#pragma once
+
+#include <cstddef>
+#include <string>
+#include <vector>
+
+class diskCache
+{
+public:
+	// Creates directory if it doesn't exist; budget is in bytes
+	diskCache(const std::string& directory, size_t budget);
+	~diskCache();
+
+	// Copies the count counts stored under key into counts and marks the entry
+	// as the most recently used. False if there is no such entry.
+	bool load(const std::string& key, int* counts, size_t count);
+
+	// Stores counts under key, replacing any entry it had; false if the file
+	// couldn't be written
+	bool store(const std::string& key, const int* counts, size_t count);
+
+private:
+	struct entry
+	{
+		std::string name;
+		size_t size;
+	};
+
+	std::string pathOf(const std::string& name) const;
+	void touch(size_t index);
+	void forget(size_t index);
+	void saveIndex();
+
+	std::string directory;
+	size_t budget;
+	size_t used;
+	// least recently used first
+	std::vector<entry> entries;
+	// entries is in a different order than the index on disk
+	bool indexChanged;
+
+	diskCache(const diskCache&);
+	diskCache& operator=(const diskCache&);
+};
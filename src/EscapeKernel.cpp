@@ -0,0 +1,238 @@
+#include "FloatContraction.h"
+#include "EscapeKernel.h"
+#include "MultiDouble.h"
+#include "FractalPolicies.h"
+#include "PointRenderer.h"
+
+using namespace std;
+
+const string kernelModeArray[2] = {"block", "streaming"};
+const string precisionTypeArray[4] = {"float", "double", "double-double", "quad-double"};
+const string coordinateTypeArray[4] = {"double", "double-double", "quad-double", "perturbation"};
+
+namespace {
+
+// One point at a time; same arithmetic and bailout test as the SIMD loops
+template<class scalar>
+struct scalarLoop
+{
+	typedef scalar real;
+
+	template<class formula>
+	static void run(const real* re, const real* im, int count, const orbitConstants& constants, int* iterations, laneStatistics* statistics)
+	{
+		unsigned long long steps = 0;
+
+		for(int i = 0; i < count; i++)
+		{
+			if(formula::interior(re[i], im[i]))
+			{
+				iterations[i] = constants.maxIterations;
+				continue;
+			}
+
+			real zRe, zIm, cRe, cIm;
+			formula::start(re[i], im[i], constants, zRe, zIm, cRe, cIm);
+
+			// Brent's cycle check, scheduled like the SIMD loops
+			real savedRe = real(8);
+			real savedIm = real(8);
+			int checkpoint = 0;
+			bool cycled = false;
+
+			int n = 0;
+			for(; n < constants.maxIterations; n++)
+			{
+				real reSquared = zRe * zRe;
+				real imSquared = zIm * zIm;
+				if(!(reSquared + imSquared <= real(4)))
+					break;
+				if(zRe == savedRe && zIm == savedIm)
+				{
+					cycled = true;
+					break;
+				}
+				if(n == checkpoint)
+				{
+					savedRe = zRe;
+					savedIm = zIm;
+					checkpoint = checkpoint * 2 + 1;
+				}
+				real reIm = zRe * zIm;
+				zRe = (reSquared - imSquared) + cRe;
+				zIm = (reIm + reIm) + cIm;
+			}
+			steps += n;
+			iterations[i] = cycled ? constants.maxIterations : n;
+		}
+
+		if(statistics != NULL)
+		{
+			statistics->usedLanes += steps;
+			statistics->totalLanes += steps;
+		}
+	}
+
+	// one point at a time leaves nothing to interleave
+	template<class firstFormula, class secondFormula>
+	static void runPair(const real* re, const real* im, int count, const orbitConstants& constants, int* firstIterations, int* secondIterations, laneStatistics* statistics)
+	{
+		run<firstFormula>(re, im, count, constants, firstIterations, statistics);
+		run<secondFormula>(re, im, count, constants, secondIterations, statistics);
+	}
+};
+
+}
+
+void scalarPointRenderers(pointRendererTable& table)
+{
+	fillPointRenderers<scalarLoop<float>, scalarLoop<double>, scalarLoop<doubleDouble> >(table.renderers[BlockKernel]);
+	fillPointRenderers<scalarLoop<float>, scalarLoop<double>, scalarLoop<doubleDouble> >(table.renderers[StreamingKernel]);
+}
+
+static pointRendererTable buildTable(void (*fill)(pointRendererTable&))
+{
+	pointRendererTable table;
+	fill(table);
+	// quad-double is scalar everywhere
+	fillFractals<scalarLoop<quadDouble> >(table.renderers[BlockKernel][QuadDoublePrecision]);
+	fillFractals<scalarLoop<quadDouble> >(table.renderers[StreamingKernel][QuadDoublePrecision]);
+	return table;
+}
+
+static const pointRendererTable& rendererTable(instructionSet isa)
+{
+#ifdef FRACTAL_X86
+	if(isa == AVX512)
+	{
+		static const pointRendererTable avx512 = buildTable(avx512PointRenderers);
+		return avx512;
+	}
+	if(isa == AVX2)
+	{
+		static const pointRendererTable avx2 = buildTable(avx2PointRenderers);
+		return avx2;
+	}
+	if(isa == SSE2)
+	{
+		static const pointRendererTable sse2 = buildTable(sse2PointRenderers);
+		return sse2;
+	}
+#endif
+	static const pointRendererTable scalar = buildTable(scalarPointRenderers);
+	return scalar;
+}
+
+pointRenderer selectPointRenderer(instructionSet isa, kernelMode mode, precisionType precision, fractalType fractal)
+{
+	return rendererTable(isa).renderers[mode][precision][fractal];
+}
+
+namespace {
+
+template<class coloring>
+void fillPalette(colorRGB* colors, int maxIterations)
+{
+	const typename coloring::palette setup = coloring::prepare(maxIterations);
+	for(int count = 0; count <= maxIterations; count++)
+		colors[count] = coloring::color(count, setup);
+}
+
+// Colors each count as it comes, for iteration limits whose table would not
+// fit in memory
+template<class coloring>
+struct directColors
+{
+	typename coloring::palette setup;
+
+	explicit directColors(int maxIterations) : setup(coloring::prepare(maxIterations)) {}
+	colorRGB operator[](int count) const { return coloring::color(count, setup); }
+};
+
+template<class fractal, class lookup>
+void lookUpColors(const orbitCounts* counts, int count, const lookup& palette, colorRGB* colors)
+{
+	for(int i = 0; i < count; i++)
+		colors[i] = fractal::color(counts[i], palette);
+}
+
+template<class fractal>
+void colorCounts(const orbitCounts* counts, int count, const colorPalette& palette, colorRGB* colors)
+{
+	if(!palette.colors.empty())
+		lookUpColors<fractal>(counts, count, &palette.colors[0], colors);
+	else if(palette.colorType == HSV)
+		lookUpColors<fractal>(counts, count, directColors<hsvColoring>(palette.maxIterations), colors);
+	else if(palette.colorType == RGB)
+		lookUpColors<fractal>(counts, count, directColors<rgbColoring<23> >(palette.maxIterations), colors);
+	else
+		lookUpColors<fractal>(counts, count, directColors<rgbColoring<25> >(palette.maxIterations), colors);
+}
+
+}
+
+void preparePalette(colorPalette& palette, colorSet colorType, int maxIterations)
+{
+	if(palette.colorType == colorType && palette.maxIterations == maxIterations)
+		return;
+
+	palette.colorType = colorType;
+	palette.maxIterations = maxIterations;
+	if(size_t(maxIterations) >= paletteLimit)
+	{
+		std::vector<colorRGB>().swap(palette.colors);
+		return;
+	}
+	palette.colors.resize(size_t(maxIterations) + 1);
+	if(colorType == HSV)
+		fillPalette<hsvColoring>(&palette.colors[0], maxIterations);
+	else if(colorType == RGB)
+		fillPalette<rgbColoring<23> >(&palette.colors[0], maxIterations);
+	else
+		fillPalette<rgbColoring<25> >(&palette.colors[0], maxIterations);
+}
+
+colorFunction selectColorFunction(fractalType fractal)
+{
+	static const colorFunction functions[4] = {
+		colorCounts<singleFractal<juliaFormula> >,
+		colorCounts<singleFractal<mandelbrotFormula> >,
+		colorCounts<blendedFractal<addedBlend> >,
+		colorCounts<blendedFractal<greaterBlend> >};
+	return functions[fractal];
+}
+
+bool parseKernelMode(const string& name, kernelMode& mode)
+{
+	if(name == "block")
+		mode = BlockKernel;
+	else if(name == "stream")
+		mode = StreamingKernel;
+	else
+		return false;
+	return true;
+}
+
+bool parsePrecision(const string& name, precisionType& precision)
+{
+	if(name == "float")
+		precision = FloatPrecision;
+	else if(name == "double")
+		precision = DoublePrecision;
+	else
+		return false;
+	return true;
+}
+
+bool parseCoordinates(const string& name, coordinateType& coordinates)
+{
+	for(int i = 0; i < 4; i++)
+	{
+		if(name == coordinateTypeArray[i])
+		{
+			coordinates = coordinateType(i);
+			return true;
+		}
+	}
+	return false;
+}
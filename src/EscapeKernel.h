@@ -0,0 +1,155 @@
+// EscapeKernel.h
+// Batched escape-time kernels. A kernel iterates z -> z^2 + c for count points
+// and writes how many iterations each orbit stayed within |z| <= 2, capped at
+// maxIterations. Bailout is tested on |z|^2, so no square roots are taken.
+//
+// Julia orbits start at the point with c = juliaConstant, Mandelbrot orbits
+// start at 0 with c = the point.
+
+#pragma once
+
+#include "CpuFeatures.h"
+#include "FractalCore.h"
+
+#include <atomic>
+#include <string>
+#include <vector>
+
+#if defined(_M_IX86) || defined(_M_X64) || defined(__i386__) || defined(__x86_64__)
+#  define FRACTAL_X86 1
+#endif
+
+// Block kernels iterate a group of points until the slowest lane is done.
+// Streaming kernels write a lane's result as soon as it escapes and reload it
+// with the next pending point, so lanes don't idle behind a long orbit.
+enum kernelMode{BlockKernel, StreamingKernel};
+
+// Float kernels run twice the lanes of double ones. Their iteration counts are
+// only exact up to 2^24, so deeper frames fall back to double. Double-double
+// and quad-double kernels (MultiDouble.h) are for deep zooms only: they take
+// offsets from orbitConstants' center instead of plane coordinates, and
+// quad-double has no lanes on any instruction set.
+enum precisionType{FloatPrecision, DoublePrecision, DoubleDoublePrecision, QuadDoublePrecision};
+
+// Coordinates a frame is iterated in, cheapest first. Double frames take
+// plane coordinates. The others take offsets from the view center, i.e. a
+// pixelGrid whose origin is 0 (DeepZoom.h): double-double and quad-double
+// (MultiDouble.h) add them to orbitConstants' center and iterate directly,
+// perturbation iterates them against a reference orbit of the center.
+enum coordinateType{DoubleCoordinates, DoubleDoubleCoordinates, QuadDoubleCoordinates, PerturbationCoordinates};
+
+extern const std::string kernelModeArray[2];
+extern const std::string precisionTypeArray[4];
+extern const std::string coordinateTypeArray[4];
+
+// Lane-iterations spent on orbits that were still running, against all
+// lane-iterations issued. Their ratio is the kernel's vector utilisation.
+struct laneStatistics
+{
+	unsigned long long usedLanes;
+	unsigned long long totalLanes;
+};
+
+// Thread-safe per-frame total of laneStatistics
+struct frameStatistics
+{
+	std::atomic<unsigned long long> usedLanes;
+	std::atomic<unsigned long long> totalLanes;
+
+	frameStatistics() : usedLanes(0), totalLanes(0) {}
+
+	void reset() { usedLanes = 0; totalLanes = 0; }
+	void add(const laneStatistics& lanes) { usedLanes += lanes.usedLanes; totalLanes += lanes.totalLanes; }
+	double utilisation() const { return totalLanes == 0 ? 1.0 : double(usedLanes) / double(totalLanes); }
+};
+
+struct perturbationReference;
+
+// View center as a quad-double, largest part first
+struct viewCenter
+{
+	double re[4];
+	double im[4];
+};
+
+// The highest iteration limit a frame may have, which keeps the iteration
+// counts of the orbit loops clear of int overflow
+const int iterationLimit = 1000000000;
+
+// Per-frame values the kernels read. Plain data so the instruction set
+// specific translation units don't have to touch std::complex. The center and
+// reference orbits are only used by the deep zoom renderers (DeepZoom.h);
+// everyone else leaves them NULL.
+struct orbitConstants
+{
+	double juliaRe;
+	double juliaIm;
+	int maxIterations;
+	const viewCenter* center;
+	const perturbationReference* juliaReference;
+	const perturbationReference* mandelbrotReference;
+};
+
+// Iterates count pixels of grid, given by their indices, for one fractal type;
+// counts[i] receives the iteration counts of pixels[i]. Every combination of
+// instruction set, kernel mode, precision and fractal is its own
+// instantiation of renderPoints() (PointRenderer.h), so there are no per-pixel
+// branches on any of them. statistics may be NULL; otherwise the lane counts
+// are added to it. Pass whole tiles rather than single rows so the streaming
+// kernels have points to refill from.
+typedef void (*pointRenderer)(const orbitConstants& constants, const pixelGrid& grid, const int* pixels, int count, orbitCounts* counts, laneStatistics* statistics);
+
+// Indexed [kernelMode][precisionType][fractalType]
+struct pointRendererTable
+{
+	pointRenderer renderers[2][4][4];
+};
+
+// The most entries a palette table gets. Frames with higher iteration limits
+// color every pixel directly rather than fill and keep a table that large;
+// their orbits take far longer than the coloring anyway.
+const size_t paletteLimit = size_t(1) << 20;
+
+// The colors of iteration counts 0 .. maxIterations in one color set; colors
+// stays empty when there are paletteLimit or more of them
+struct colorPalette
+{
+	colorSet colorType;
+	int maxIterations;
+	std::vector<colorRGB> colors;
+
+	colorPalette() : colorType(HSV), maxIterations(-1) {}
+};
+
+// Fills palette for the color set and iteration limit, unless it already
+// holds them; keep one palette around and prepare it once per frame
+void preparePalette(colorPalette& palette, colorSet colorType, int maxIterations);
+
+// Maps count pixels' iteration counts to colors for one fractal type by
+// looking them up in palette. Runs no orbits, so changing the colors of a
+// frame is one linear pass over its counts.
+typedef void (*colorFunction)(const orbitCounts* counts, int count, const colorPalette& palette, colorRGB* colors);
+
+colorFunction selectColorFunction(fractalType fractal);
+
+void scalarPointRenderers(pointRendererTable& table);
+#ifdef FRACTAL_X86
+void sse2PointRenderers(pointRendererTable& table);
+void avx2PointRenderers(pointRendererTable& table);
+void avx512PointRenderers(pointRendererTable& table);
+#endif
+
+// Renderer for the given instruction set, falling back to narrower ones that
+// were compiled in. The caller is responsible for checking CPU support. The
+// scalar renderers have no lanes, so they ignore the mode.
+pointRenderer selectPointRenderer(instructionSet isa, kernelMode mode, precisionType precision, fractalType fractal);
+
+// Parses "block" or "stream"; returns false for anything else
+bool parseKernelMode(const std::string& name, kernelMode& mode);
+
+// Parses "float" or "double"; returns false for anything else
+bool parsePrecision(const std::string& name, precisionType& precision);
+
+// Parses "double", "double-double", "quad-double" or "perturbation"; returns
+// false for anything else
+bool parseCoordinates(const std::string& name, coordinateType& coordinates);
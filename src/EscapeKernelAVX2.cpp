@@ -0,0 +1,83 @@
+// AVX2 escape kernels, 4 doubles or 8 floats per instruction
+
+#include "FloatContraction.h"
+#include "EscapeKernel.h"
+
+#ifdef FRACTAL_X86
+
+#include <immintrin.h>
+
+#if defined(__GNUC__) && !defined(__clang__)
+#  pragma GCC target("avx2")
+#elif defined(__clang__)
+#  pragma clang attribute push(__attribute__((target("avx2"))), apply_to = function)
+#endif
+
+namespace {
+
+struct avx2Double
+{
+	typedef double scalar;
+	typedef __m256d real;
+	typedef __m256d mask;
+	enum { width = 4 };
+
+	static real load(const double* p) { return _mm256_loadu_pd(p); }
+	static real broadcast(double value) { return _mm256_set1_pd(value); }
+	static real add(real a, real b) { return _mm256_add_pd(a, b); }
+	static real sub(real a, real b) { return _mm256_sub_pd(a, b); }
+	static real mul(real a, real b) { return _mm256_mul_pd(a, b); }
+	static mask lessEqual(real a, real b) { return _mm256_cmp_pd(a, b, _CMP_LE_OQ); }
+	static mask lessThan(real a, real b) { return _mm256_cmp_pd(a, b, _CMP_LT_OQ); }
+	static mask equal(real a, real b) { return _mm256_cmp_pd(a, b, _CMP_EQ_OQ); }
+	static mask both(mask a, mask b) { return _mm256_and_pd(a, b); }
+	static mask without(mask a, mask b) { return _mm256_andnot_pd(b, a); }
+	static bool any(mask m) { return _mm256_movemask_pd(m) != 0; }
+	static int bits(mask m) { return _mm256_movemask_pd(m); }
+	static real addWhere(real a, real b, mask m) { return _mm256_add_pd(a, _mm256_and_pd(b, m)); }
+	static real choose(mask m, real a, real b) { return _mm256_blendv_pd(b, a, m); }
+	static void store(double* p, real value) { _mm256_storeu_pd(p, value); }
+};
+
+struct avx2Float
+{
+	typedef float scalar;
+	typedef __m256 real;
+	typedef __m256 mask;
+	enum { width = 8 };
+
+	static real load(const float* p) { return _mm256_loadu_ps(p); }
+	static real broadcast(float value) { return _mm256_set1_ps(value); }
+	static real add(real a, real b) { return _mm256_add_ps(a, b); }
+	static real sub(real a, real b) { return _mm256_sub_ps(a, b); }
+	static real mul(real a, real b) { return _mm256_mul_ps(a, b); }
+	static mask lessEqual(real a, real b) { return _mm256_cmp_ps(a, b, _CMP_LE_OQ); }
+	static mask lessThan(real a, real b) { return _mm256_cmp_ps(a, b, _CMP_LT_OQ); }
+	static mask equal(real a, real b) { return _mm256_cmp_ps(a, b, _CMP_EQ_OQ); }
+	static mask both(mask a, mask b) { return _mm256_and_ps(a, b); }
+	static mask without(mask a, mask b) { return _mm256_andnot_ps(b, a); }
+	static bool any(mask m) { return _mm256_movemask_ps(m) != 0; }
+	static int bits(mask m) { return _mm256_movemask_ps(m); }
+	static real addWhere(real a, real b, mask m) { return _mm256_add_ps(a, _mm256_and_ps(b, m)); }
+	static real choose(mask m, real a, real b) { return _mm256_blendv_ps(b, a, m); }
+	static void store(float* p, real value) { _mm256_storeu_ps(p, value); }
+};
+
+}
+
+#include "MultiDouble.h"
+#include "SimdKernel.h"
+#include "FractalPolicies.h"
+#include "PointRenderer.h"
+
+void avx2PointRenderers(pointRendererTable& table)
+{
+	fillPointRenderers<blockLoop<avx2Float>, blockLoop<avx2Double>, blockLoop<doubleDoubleLanes<avx2Double> > >(table.renderers[BlockKernel]);
+	fillPointRenderers<streamingLoop<avx2Float>, streamingLoop<avx2Double>, streamingLoop<doubleDoubleLanes<avx2Double> > >(table.renderers[StreamingKernel]);
+}
+
+#if defined(__clang__)
+#  pragma clang attribute pop
+#endif
+
+#endif
@@ -0,0 +1,83 @@
+// AVX-512 escape kernels, 8 doubles or 16 floats per instruction
+
+#include "FloatContraction.h"
+#include "EscapeKernel.h"
+
+#ifdef FRACTAL_X86
+
+#include <immintrin.h>
+
+#if defined(__GNUC__) && !defined(__clang__)
+#  pragma GCC target("avx512f")
+#elif defined(__clang__)
+#  pragma clang attribute push(__attribute__((target("avx512f"))), apply_to = function)
+#endif
+
+namespace {
+
+struct avx512Double
+{
+	typedef double scalar;
+	typedef __m512d real;
+	typedef __mmask8 mask;
+	enum { width = 8 };
+
+	static real load(const double* p) { return _mm512_loadu_pd(p); }
+	static real broadcast(double value) { return _mm512_set1_pd(value); }
+	static real add(real a, real b) { return _mm512_add_pd(a, b); }
+	static real sub(real a, real b) { return _mm512_sub_pd(a, b); }
+	static real mul(real a, real b) { return _mm512_mul_pd(a, b); }
+	static mask lessEqual(real a, real b) { return _mm512_cmp_pd_mask(a, b, _CMP_LE_OQ); }
+	static mask lessThan(real a, real b) { return _mm512_cmp_pd_mask(a, b, _CMP_LT_OQ); }
+	static mask equal(real a, real b) { return _mm512_cmp_pd_mask(a, b, _CMP_EQ_OQ); }
+	static mask both(mask a, mask b) { return mask(a & b); }
+	static mask without(mask a, mask b) { return mask(a & ~b); }
+	static bool any(mask m) { return m != 0; }
+	static int bits(mask m) { return int(m); }
+	static real addWhere(real a, real b, mask m) { return _mm512_mask_add_pd(a, m, a, b); }
+	static real choose(mask m, real a, real b) { return _mm512_mask_blend_pd(m, b, a); }
+	static void store(double* p, real value) { _mm512_storeu_pd(p, value); }
+};
+
+struct avx512Float
+{
+	typedef float scalar;
+	typedef __m512 real;
+	typedef __mmask16 mask;
+	enum { width = 16 };
+
+	static real load(const float* p) { return _mm512_loadu_ps(p); }
+	static real broadcast(float value) { return _mm512_set1_ps(value); }
+	static real add(real a, real b) { return _mm512_add_ps(a, b); }
+	static real sub(real a, real b) { return _mm512_sub_ps(a, b); }
+	static real mul(real a, real b) { return _mm512_mul_ps(a, b); }
+	static mask lessEqual(real a, real b) { return _mm512_cmp_ps_mask(a, b, _CMP_LE_OQ); }
+	static mask lessThan(real a, real b) { return _mm512_cmp_ps_mask(a, b, _CMP_LT_OQ); }
+	static mask equal(real a, real b) { return _mm512_cmp_ps_mask(a, b, _CMP_EQ_OQ); }
+	static mask both(mask a, mask b) { return mask(a & b); }
+	static mask without(mask a, mask b) { return mask(a & ~b); }
+	static bool any(mask m) { return m != 0; }
+	static int bits(mask m) { return int(m); }
+	static real addWhere(real a, real b, mask m) { return _mm512_mask_add_ps(a, m, a, b); }
+	static real choose(mask m, real a, real b) { return _mm512_mask_blend_ps(m, b, a); }
+	static void store(float* p, real value) { _mm512_storeu_ps(p, value); }
+};
+
+}
+
+#include "MultiDouble.h"
+#include "SimdKernel.h"
+#include "FractalPolicies.h"
+#include "PointRenderer.h"
+
+void avx512PointRenderers(pointRendererTable& table)
+{
+	fillPointRenderers<blockLoop<avx512Float>, blockLoop<avx512Double>, blockLoop<doubleDoubleLanes<avx512Double> > >(table.renderers[BlockKernel]);
+	fillPointRenderers<streamingLoop<avx512Float>, streamingLoop<avx512Double>, streamingLoop<doubleDoubleLanes<avx512Double> > >(table.renderers[StreamingKernel]);
+}
+
+#if defined(__clang__)
+#  pragma clang attribute pop
+#endif
+
+#endif
@@ -0,0 +1,83 @@
+// SSE2 escape kernels, 2 doubles or 4 floats per instruction
+
+#include "FloatContraction.h"
+#include "EscapeKernel.h"
+
+#ifdef FRACTAL_X86
+
+#include <emmintrin.h>
+
+#if defined(__GNUC__) && !defined(__clang__)
+#  pragma GCC target("sse2")
+#elif defined(__clang__)
+#  pragma clang attribute push(__attribute__((target("sse2"))), apply_to = function)
+#endif
+
+namespace {
+
+struct sse2Double
+{
+	typedef double scalar;
+	typedef __m128d real;
+	typedef __m128d mask;
+	enum { width = 2 };
+
+	static real load(const double* p) { return _mm_loadu_pd(p); }
+	static real broadcast(double value) { return _mm_set1_pd(value); }
+	static real add(real a, real b) { return _mm_add_pd(a, b); }
+	static real sub(real a, real b) { return _mm_sub_pd(a, b); }
+	static real mul(real a, real b) { return _mm_mul_pd(a, b); }
+	static mask lessEqual(real a, real b) { return _mm_cmple_pd(a, b); }
+	static mask lessThan(real a, real b) { return _mm_cmplt_pd(a, b); }
+	static mask equal(real a, real b) { return _mm_cmpeq_pd(a, b); }
+	static mask both(mask a, mask b) { return _mm_and_pd(a, b); }
+	static mask without(mask a, mask b) { return _mm_andnot_pd(b, a); }
+	static bool any(mask m) { return _mm_movemask_pd(m) != 0; }
+	static int bits(mask m) { return _mm_movemask_pd(m); }
+	static real addWhere(real a, real b, mask m) { return _mm_add_pd(a, _mm_and_pd(b, m)); }
+	static real choose(mask m, real a, real b) { return _mm_or_pd(_mm_and_pd(m, a), _mm_andnot_pd(m, b)); }
+	static void store(double* p, real value) { _mm_storeu_pd(p, value); }
+};
+
+struct sse2Float
+{
+	typedef float scalar;
+	typedef __m128 real;
+	typedef __m128 mask;
+	enum { width = 4 };
+
+	static real load(const float* p) { return _mm_loadu_ps(p); }
+	static real broadcast(float value) { return _mm_set1_ps(value); }
+	static real add(real a, real b) { return _mm_add_ps(a, b); }
+	static real sub(real a, real b) { return _mm_sub_ps(a, b); }
+	static real mul(real a, real b) { return _mm_mul_ps(a, b); }
+	static mask lessEqual(real a, real b) { return _mm_cmple_ps(a, b); }
+	static mask lessThan(real a, real b) { return _mm_cmplt_ps(a, b); }
+	static mask equal(real a, real b) { return _mm_cmpeq_ps(a, b); }
+	static mask both(mask a, mask b) { return _mm_and_ps(a, b); }
+	static mask without(mask a, mask b) { return _mm_andnot_ps(b, a); }
+	static bool any(mask m) { return _mm_movemask_ps(m) != 0; }
+	static int bits(mask m) { return _mm_movemask_ps(m); }
+	static real addWhere(real a, real b, mask m) { return _mm_add_ps(a, _mm_and_ps(b, m)); }
+	static real choose(mask m, real a, real b) { return _mm_or_ps(_mm_and_ps(m, a), _mm_andnot_ps(m, b)); }
+	static void store(float* p, real value) { _mm_storeu_ps(p, value); }
+};
+
+}
+
+#include "MultiDouble.h"
+#include "SimdKernel.h"
+#include "FractalPolicies.h"
+#include "PointRenderer.h"
+
+void sse2PointRenderers(pointRendererTable& table)
+{
+	fillPointRenderers<blockLoop<sse2Float>, blockLoop<sse2Double>, blockLoop<doubleDoubleLanes<sse2Double> > >(table.renderers[BlockKernel]);
+	fillPointRenderers<streamingLoop<sse2Float>, streamingLoop<sse2Double>, streamingLoop<doubleDoubleLanes<sse2Double> > >(table.renderers[StreamingKernel]);
+}
+
+#if defined(__clang__)
+#  pragma clang attribute pop
+#endif
+
+#endif
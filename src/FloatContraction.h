@@ -0,0 +1,17 @@
+// FloatContraction.h
+// Keeps the compiler from fusing a multiply and an add into one FMA, which
+// rounds once instead of twice. GCC does that by default wherever the target
+// has FMA (avx512f implies it), so the AVX-512 loops would count differently
+// from the others, and the Dekker products of MultiDouble.h would no longer
+// be exact. Include it first in every translation unit that iterates orbits,
+// so everything it defines is compiled the same way.
+
+#pragma once
+
+#if defined(__clang__)
+#  pragma STDC FP_CONTRACT OFF
+#elif defined(__GNUC__)
+#  pragma GCC optimize("fp-contract=off")
+#elif defined(_MSC_VER)
+#  pragma fp_contract(off)
+#endif
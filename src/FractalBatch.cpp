@@ -0,0 +1,451 @@
+// FractalBatch.cpp
+// Headless renderer: renders one frame with the same escape-time code as the
+// viewer and writes it straight to disk. Needs no display, GLUT or GLEW.
+
+#include "FractalCore.h"
+#include "DeepZoom.h"
+#include "EscapeKernel.h"
+#include "FractalEngine.h"
+#include "FrameBuffers.h"
+#include "ImageWriter.h"
+#include "TileScheduler.h"
+
+#include <algorithm>
+#include <atomic>
+#include <cfloat>
+#include <chrono>
+#include <cstdlib>
+#include <iostream>
+#include <vector>
+
+using namespace std;
+
+struct batchOptions
+{
+	fractalType fractal;
+	colorSet colorType;
+	complex<double> juliaConstant;
+	viewport view;
+	string centerText[2];
+	bool autoCoordinates;
+	coordinateType coordinates;
+	int maxIterations;
+	unsigned int threads;
+	int tileSize;
+	int bandRows;
+	instructionSet isa;
+	kernelMode mode;
+	precisionType precision;
+	bool subdivide;
+	bool verify;
+	bool crossCheck;
+	bool help;
+	string output;
+};
+
+static void printUsage(ostream& out, const char* program)
+{
+	out << "Usage: " << program << " [options]" << endl
+		<< "  -fractal julia|mandelbrot|mixed|greater  fractal type (default julia)" << endl
+		<< "  -julia <re> <im>                         Julia constant" << endl
+		<< "  -juliaindex <0-11>                       use one of the viewer's Julia constants (default 0)" << endl
+		<< "  -center <x> <y>                          center of the view, at any precision (default 0 0)" << endl
+		<< "  -scale <s>                               distance from the center to the left edge (default 1)" << endl
+		<< "  -size <width> <height>                   image size in pixels (default 500 500)" << endl
+		<< "  -iterations <n>                          maximum iterations (default 100)" << endl
+		<< "  -colors hsv|rgb|rgbshift                 color set (default hsv)" << endl
+		<< "  -threads <n>                             render threads, 0 for one per core (default 0)" << endl
+		<< "  -tile <n>                                tile size in pixels, 0 to pick one per frame (default 0)" << endl
+		<< "  -band <n>                                render and write the image n rows at a time, 0 for bands" << endl
+		<< "                                           of about 16 million pixels (default 0)" << endl
+		<< "  -isa scalar|sse2|avx2|avx512             escape kernel (default: widest the CPU supports)" << endl
+		<< "  -kernel block|stream                     SIMD kernel mode (default stream)" << endl
+		<< "  -precision float|double                  kernel precision (default double)" << endl
+		<< "  -subdivide                               Mariani-Silver subdivision instead of every pixel" << endl
+		<< "  -verify                                  also render every pixel and count the pixels that differ" << endl
+		<< "  -crosscheck                              also render with every other instruction set the CPU" << endl
+		<< "                                           supports and count the pixels whose iterations differ" << endl
+		<< "  -coordinates auto|double|double-double|quad-double|perturbation" << endl
+		<< "                                           what pixels are iterated in (default: the cheapest that" << endl
+		<< "                                           resolves them)" << endl
+		<< "  -o <file>                                output image, .png or .ppm (default fractal.ppm)" << endl
+		<< "  -help                                    print this list and exit" << endl;
+}
+
+static bool parseArguments(int argc, char** argv, batchOptions& options)
+{
+	options.fractal = Julia;
+	options.colorType = HSV;
+	options.juliaConstant = juliaSetArray[0];
+	options.view.centerX = 0.0;
+	options.view.centerY = 0.0;
+	options.centerText[0] = "0";
+	options.centerText[1] = "0";
+	options.autoCoordinates = true;
+	options.coordinates = DoubleCoordinates;
+	options.view.scale = 1.0;
+	options.view.width = 500;
+	options.view.height = 500;
+	options.maxIterations = 100;
+	options.threads = 0;
+	options.tileSize = 0;
+	options.bandRows = 0;
+	options.isa = detectInstructionSet();
+	options.mode = StreamingKernel;
+	options.precision = DoublePrecision;
+	options.subdivide = false;
+	options.verify = false;
+	options.crossCheck = false;
+	options.help = false;
+	options.output = "fractal.ppm";
+
+	for(int i = 1; i < argc; i++)
+	{
+		string argument = argv[i];
+		int remaining = argc - i - 1;
+
+		if(argument == "-help" || argument == "-h")
+		{
+			options.help = true;
+			return true;
+		}
+		else if(argument == "-fractal" && remaining >= 1)
+		{
+			string name = argv[++i];
+			if(name == "julia")
+				options.fractal = Julia;
+			else if(name == "mandelbrot")
+				options.fractal = Mandelbrot;
+			else if(name == "mixed")
+				options.fractal = Mixed;
+			else if(name == "greater")
+				options.fractal = Greater;
+			else
+			{
+				cerr << "Unknown fractal type '" << name << "'" << endl;
+				return false;
+			}
+		}
+		else if(argument == "-julia" && remaining >= 2)
+		{
+			double re = atof(argv[++i]);
+			double im = atof(argv[++i]);
+			options.juliaConstant = complex<double>(re, im);
+		}
+		else if(argument == "-juliaindex" && remaining >= 1)
+		{
+			int index = atoi(argv[++i]);
+			if(index < 0 || index > 11)
+			{
+				cerr << "Julia index must be between 0 and 11" << endl;
+				return false;
+			}
+			options.juliaConstant = juliaSetArray[index];
+		}
+		else if(argument == "-center" && remaining >= 2)
+		{
+			options.centerText[0] = argv[++i];
+			options.centerText[1] = argv[++i];
+			options.view.centerX = atof(options.centerText[0].c_str());
+			options.view.centerY = atof(options.centerText[1].c_str());
+		}
+		else if(argument == "-scale" && remaining >= 1)
+			options.view.scale = atof(argv[++i]);
+		else if(argument == "-size" && remaining >= 2)
+		{
+			options.view.width = atoi(argv[++i]);
+			options.view.height = atoi(argv[++i]);
+		}
+		else if(argument == "-iterations" && remaining >= 1)
+		{
+			const char* text = argv[++i];
+			char* end;
+			long value = strtol(text, &end, 10);
+			if(end == text || *end != '\0' || value < 1 || value > iterationLimit)
+			{
+				cerr << "Iterations must be a whole number from 1 to " << iterationLimit << ", not '" << text << "'" << endl;
+				return false;
+			}
+			options.maxIterations = int(value);
+		}
+		else if(argument == "-colors" && remaining >= 1)
+		{
+			string name = argv[++i];
+			if(name == "hsv")
+				options.colorType = HSV;
+			else if(name == "rgb")
+				options.colorType = RGB;
+			else if(name == "rgbshift")
+				options.colorType = RGBShift;
+			else
+			{
+				cerr << "Unknown color set '" << name << "'" << endl;
+				return false;
+			}
+		}
+		else if(argument == "-threads" && remaining >= 1)
+			options.threads = (unsigned int)atoi(argv[++i]);
+		else if(argument == "-tile" && remaining >= 1)
+			options.tileSize = atoi(argv[++i]);
+		else if(argument == "-band" && remaining >= 1)
+			options.bandRows = atoi(argv[++i]);
+		else if(argument == "-isa" && remaining >= 1)
+		{
+			string name = argv[++i];
+			if(!parseInstructionSet(name, options.isa))
+			{
+				cerr << "Unknown instruction set '" << name << "'" << endl;
+				return false;
+			}
+			if(options.isa > detectInstructionSet())
+			{
+				cerr << "This CPU does not support " << instructionSetArray[options.isa] << endl;
+				return false;
+			}
+		}
+		else if(argument == "-kernel" && remaining >= 1)
+		{
+			string name = argv[++i];
+			if(!parseKernelMode(name, options.mode))
+			{
+				cerr << "Unknown kernel mode '" << name << "'" << endl;
+				return false;
+			}
+		}
+		else if(argument == "-precision" && remaining >= 1)
+		{
+			string name = argv[++i];
+			if(!parsePrecision(name, options.precision))
+			{
+				cerr << "Unknown precision '" << name << "'" << endl;
+				return false;
+			}
+		}
+		else if(argument == "-subdivide")
+			options.subdivide = true;
+		else if(argument == "-verify")
+			options.verify = true;
+		else if(argument == "-crosscheck")
+			options.crossCheck = true;
+		else if(argument == "-coordinates" && remaining >= 1)
+		{
+			string name = argv[++i];
+			options.autoCoordinates = name == "auto";
+			if(!options.autoCoordinates && !parseCoordinates(name, options.coordinates))
+			{
+				cerr << "Unknown coordinates '" << name << "'" << endl;
+				return false;
+			}
+		}
+		else if(argument == "-o" && remaining >= 1)
+			options.output = argv[++i];
+		else
+		{
+			cerr << "Unknown or incomplete option '" << argument << "'" << endl;
+			return false;
+		}
+	}
+
+	if(options.view.width < 2 || options.view.height < 2 || options.maxIterations < 1 || !(options.view.scale > 0.0) || options.tileSize < 0 || options.bandRows < 0)
+	{
+		cerr << "Size must be at least 2x2, iterations at least 1, scale positive and tile and band size not negative" << endl;
+		return false;
+	}
+	if(!renderableSpacing(options.view.scale / (options.view.width / 2.0)))
+	{
+		cerr << "Scale too small: pixels closer than the smallest normal double (about 2e-308) can't be rendered" << endl;
+		return false;
+	}
+	return true;
+}
+
+// The frame options describe. Double frames take the center as atof() read
+// it, deeper ones every digit that matters at the frame's pixel spacing.
+static bool makeRequest(const batchOptions& options, frameRequest& request)
+{
+	const viewport& view = options.view;
+	const double spacing = view.scale / (view.width / 2.0);
+
+	request.fractal = options.fractal;
+	request.colorType = options.colorType;
+	request.juliaConstant = options.juliaConstant;
+	request.scale = view.scale;
+	request.width = view.width;
+	request.height = view.height;
+	request.maxIterations = options.maxIterations;
+	request.coordinates = options.autoCoordinates ? coordinatesFor(spacing) : options.coordinates;
+	request.isa = options.isa;
+	request.mode = options.mode;
+	request.precision = options.precision;
+	request.subdivide = options.subdivide;
+	request.tileSize = options.tileSize;
+
+	if(request.coordinates == DoubleCoordinates)
+	{
+		request.centerX = bigFloat(view.centerX, bigFloat::maxWords);
+		request.centerY = bigFloat(view.centerY, bigFloat::maxWords);
+		return true;
+	}
+	int words = bigFloat::wordsFor(spacing);
+	if(!bigFloat::parse(options.centerText[0], words, request.centerX) || !bigFloat::parse(options.centerText[1], words, request.centerY))
+	{
+		cerr << "Cannot read the center " << options.centerText[0] << " " << options.centerText[1] << endl;
+		return false;
+	}
+	return true;
+}
+
+// The kernel renderFrame() picks for request: perturbation and quad-double
+// only have a scalar one, and float frames past 2^24 iterations run in double
+static string kernelName(const frameRequest& request)
+{
+	if(request.coordinates == PerturbationCoordinates)
+		return "scalar perturbation";
+	if(request.coordinates == QuadDoubleCoordinates)
+		return "scalar quad-double";
+	precisionType precision = request.maxIterations > (1 << 24) ? DoublePrecision : request.precision;
+	if(request.coordinates == DoubleDoubleCoordinates)
+		precision = DoubleDoublePrecision;
+	return instructionSetArray[request.isa] + " " + kernelModeArray[request.mode] + " " + precisionTypeArray[precision];
+}
+
+// Rows per band. Picked bands are about 16 million pixels (48 MB of RGB), so
+// a frame that size or smaller renders at once. Picked bands, and those -band
+// asks for when subdividing, are a whole number of tiles high, so subdividing
+// them cuts the same tiles as the whole frame would.
+static int bandRowsFor(const batchOptions& options, frameRequest& request)
+{
+	const int height = request.height;
+	if(options.bandRows >= height)
+		return height;
+	if(options.bandRows > 0 && !request.subdivide)
+		return options.bandRows;
+
+	const long long bandPixels = 1 << 24;
+	if(options.bandRows == 0 && (long long)request.width * height <= bandPixels)
+		return height;
+	if(request.tileSize == 0)
+		request.tileSize = 64;
+	const int asked = options.bandRows > 0 ? options.bandRows : int(bandPixels / request.width);
+	const int rows = min(max(asked / request.tileSize, 1) * request.tileSize, height);
+	if(options.bandRows > 0 && rows != options.bandRows)
+		cout << "Subdividing needs bands a whole number of " << request.tileSize << " pixel tiles high, so they are " << rows << " rows" << endl;
+	return rows;
+}
+
+int main(int argc, char** argv)
+{
+	batchOptions options;
+	if(!parseArguments(argc, argv, options))
+	{
+		printUsage(cerr, argv[0]);
+		return EXIT_FAILURE;
+	}
+	if(options.help)
+	{
+		printUsage(cout, argv[0]);
+		return EXIT_SUCCESS;
+	}
+
+	const viewport& view = options.view;
+	frameRequest request;
+	if(!makeRequest(options, request))
+		return EXIT_FAILURE;
+	const int bandRows = bandRowsFor(options, request);
+	tileScheduler scheduler(options.threads);
+
+	// only a band is ever in memory; each goes to the file once it is rendered
+	frameVector<unsigned char> pixels(size_t(view.width) * bandRows * 3);
+	frameVector<unsigned char> reference(options.verify || options.crossCheck ? pixels.size() : 0);
+	frameVector<orbitCounts> counts(options.crossCheck ? size_t(view.width) * bandRows : 0);
+	frameVector<orbitCounts> otherCounts(counts.size());
+	imageStream image;
+	if(!image.open(options.output, view.width, view.height))
+	{
+		cerr << "Failed to write " << options.output << endl;
+		return EXIT_FAILURE;
+	}
+
+	cout << "Rendering " << fractalTypeArray[options.fractal] << " " << view.width << "x" << view.height
+		<< " at " << options.maxIterations << " iterations on " << scheduler.threadCount() << " threads with the "
+		<< kernelName(request) << " kernel..." << endl;
+	if(bandRows < view.height)
+		cout << "Streaming " << (view.height + bandRows - 1) / bandRows << " bands of " << bandRows << " rows to " << options.output << endl;
+
+	// prepares the kernels and reference orbits once for every band; the brute
+	// force check iterates the same points the same way
+	frameRenderer renderer;
+	rowTarget band;
+	band.pixels = &pixels[0];
+	band.counts = options.crossCheck ? &counts[0] : NULL;
+	rowTarget check;
+	check.pixels = options.verify ? &reference[0] : NULL;
+	frameRequest bruteForce = request;
+	bruteForce.subdivide = false;
+	double renderSeconds = 0.0;
+	long long computedPixels = 0;
+	frameStatistics lanes;
+	long long differing = 0;
+	long long kernelsDiffering = 0;
+	for(int firstRow = 0; firstRow < view.height; firstRow += bandRows)
+	{
+		const int rows = min(bandRows, view.height - firstRow);
+		frameReport report;
+		renderer.renderRows(scheduler, request, firstRow, rows, band, report);
+		renderSeconds += report.renderSeconds;
+		computedPixels += report.computedPixels;
+		lanes.add(report.lanes);
+
+		if(firstRow == 0 && request.coordinates == PerturbationCoordinates)
+			cout << "Deep zoom: " << report.referenceBits << " bit reference orbit of " << report.referencePoints
+				<< " points in " << report.referenceSeconds << " s, series skips " << report.skippedIterations << " iterations" << endl;
+
+		if(options.verify)
+		{
+			renderer.renderRows(scheduler, bruteForce, firstRow, rows, check, report);
+			for(size_t i = 0; i < size_t(view.width) * rows * 3; i += 3)
+			{
+				if(pixels[i] != reference[i] || pixels[i + 1] != reference[i + 1] || pixels[i + 2] != reference[i + 2])
+					++differing;
+			}
+		}
+
+		// every kernel has to count exactly alike, the disk cache depends on it
+		for(int isa = Scalar; options.crossCheck && isa <= detectInstructionSet(); isa++)
+		{
+			if(isa == request.isa)
+				continue;
+			frameRequest other = request;
+			other.isa = (instructionSet)isa;
+			renderRows(scheduler, other, firstRow, rows, &reference[0], &otherCounts[0], report);
+			for(size_t i = 0; i < size_t(view.width) * rows; i++)
+			{
+				if(counts[i].julia != otherCounts[i].julia || counts[i].mandelbrot != otherCounts[i].mandelbrot)
+					++kernelsDiffering;
+			}
+		}
+
+		if(!image.write(&pixels[0], rows))
+		{
+			cerr << "Failed to write " << options.output << endl;
+			return EXIT_FAILURE;
+		}
+	}
+
+	double megapixels = double(view.width) * view.height / 1.0e6;
+	cout << "Rendered in " << renderSeconds << " s (" << megapixels / renderSeconds << " Mpixel/s)" << endl;
+	cout << "Lane utilisation " << lanes.utilisation() * 100.0 << "%" << endl;
+	cout << "Computed " << 100.0 * computedPixels / (double(view.width) * view.height) << "% of the pixels" << endl;
+	if(options.verify)
+		cout << "Verification: " << differing << " pixels differ from the brute force render" << endl;
+	if(options.crossCheck)
+		cout << "Cross-check: " << kernelsDiffering << " pixels count differently on the other instruction sets" << endl;
+
+	if(!image.close())
+	{
+		cerr << "Failed to write " << options.output << endl;
+		return EXIT_FAILURE;
+	}
+	cout << "Wrote " << options.output << endl;
+	return differing == 0 && kernelsDiffering == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,21 @@
+#include "FractalCore.h"
+
+using namespace std;
+
+const string fractalTypeArray[4] = {"Julia", "Mandelbrot", "Mixed - Added", "Mixed - Greater"};
+const string colorSetArray[3] = {"HSV", "RGB shifted 23", "RGB shifted 25"};
+
+const complex<double> juliaSetArray [12] = {
+	complex<double>(-0.8, 0.156),
+	complex<double>(-0.4, 0.6),
+	complex<double>(-.62772, .42193),
+	complex<double>(0.3515, -0.07467),
+	complex<double>(-0.391, -0.587),
+	complex<double>(0.233, 0.53780),
+	complex<double>(-0.74543, 0.11301),
+	complex<double>(-0.74434, -0.10722),
+	complex<double>(0.285, 0.01),
+	complex<double>(0.45, 0.1428),
+	complex<double>(-0.70176, -0.3842),
+	complex<double>(-0.835, -0.2321)
+};
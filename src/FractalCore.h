@@ -0,0 +1,95 @@
+// FractalCore.h
+// Fractal and color set definitions shared by the GLUT viewer (FractalRenderer.cpp)
+// and the headless batch renderer (FractalBatch.cpp). The kernels that color
+// points are declared in EscapeKernel.h.
+// Nothing in here may include Angel.h or touch OpenGL, GLUT or GLEW.
+
+#pragma once
+
+#include <complex>
+#include <string>
+
+enum fractalType{Julia, Mandelbrot, Mixed, Greater};
+enum colorSet{HSV, RGB, RGBShift};
+
+extern const std::string fractalTypeArray[4];
+extern const std::string colorSetArray[3];
+extern const std::complex<double> juliaSetArray[12];
+
+struct colorRGB
+{
+	float red;
+	float green;
+	float blue;
+};
+
+// Iterations a pixel's orbits stayed bounded. Mixed and Greater have both;
+// Julia and Mandelbrot leave the other count at 0. Colors are computed from
+// these in a separate pass (selectColorFunction() in EscapeKernel.h).
+struct orbitCounts
+{
+	int julia;
+	int mandelbrot;
+};
+
+// A color channel in [0,1] as an 8-bit value, clamped the way GL clamps
+// float colors; the viewer's display texture and the batch images both use it
+inline unsigned char toByte(float channel)
+{
+	if(!(channel > 0.0f))
+		return 0;
+	if(channel >= 1.0f)
+		return 255;
+	return (unsigned char)(channel * 255.0f + 0.5f);
+}
+
+// A rectangular window onto the complex plane. Pixel (width/2, height/2) sits on
+// the center and the left edge is scale away from it (scale 1.0 covers
+// [-1,1] x [-1,1]), the same for the viewer and the batch renderer.
+struct viewport
+{
+	double centerX;
+	double centerY;
+	double scale;
+	int width;
+	int height;
+};
+
+// Where the pixels of a frame are: pixel (x, y) sits at
+// (originRe + (x - originX) * stepRe, originIm - (y - originY) * stepIm), as
+// rows run down the screen but up the plane. Pixels are indexed y * width + x.
+// The kernels compute coordinates from this, so changing the view only
+// changes these numbers.
+struct pixelGrid
+{
+	double originRe;
+	double originIm;
+	int originX;
+	int originY;
+	double stepRe;
+	double stepIm;
+	int width;
+};
+
+inline pixelGrid viewportGrid(const viewport& view)
+{
+	pixelGrid grid;
+	grid.originRe = view.centerX;
+	grid.originIm = view.centerY;
+	grid.originX = view.width / 2;
+	grid.originY = view.height / 2;
+	grid.stepRe = view.scale / (view.width / 2.0);
+	grid.stepIm = view.scale / (view.height / 2.0);
+	grid.width = view.width;
+	return grid;
+}
+
+// The same pixels, indexed from the corner (x, y) of a tile width pixels wide
+inline pixelGrid tileGrid(const pixelGrid& grid, int x, int y, int width)
+{
+	pixelGrid tile = grid;
+	tile.originX -= x;
+	tile.originY -= y;
+	tile.width = width;
+	return tile;
+}
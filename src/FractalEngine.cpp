@@ -0,0 +1,315 @@
+#include "FractalEngine.h"
+#include "TileSubdivision.h"
+
+#include <atomic>
+#include <chrono>
+#include <vector>
+
+using namespace std;
+
+int layersOf(fractalType fractal)
+{
+	return fractal == Julia ? juliaLayer : fractal == Mandelbrot ? mandelbrotLayer : juliaLayer | mandelbrotLayer;
+}
+
+void copyLayers(orbitCounts& to, const orbitCounts& from, int layers)
+{
+	if(layers & juliaLayer)
+		to.julia = from.julia;
+	if(layers & mandelbrotLayer)
+		to.mandelbrot = from.mandelbrot;
+}
+
+// What the tiles of one call read and write; lives on the stack of
+// frameRenderer::renderRows()
+struct engineFrame
+{
+	const pixelGrid* grid;
+	const pointRenderer* renderers;
+	const orbitConstants* constants;
+	int layers;
+	colorFunction colors;
+	const colorPalette* palette;
+	bool subdivide;
+	int width;
+	// of the band the tiles are in
+	int firstRow;
+	const rowTarget* target;
+	frameStatistics statistics;
+	atomic<long long> computedPixels;
+	atomic<int> computedLayers;
+};
+
+// Per-tile state for iteratePixels(): the renderer of some layers
+struct tileJob
+{
+	const engineFrame* frame;
+	pointRenderer renderer;
+	laneStatistics lanes;
+};
+
+static void iteratePixels(const tile& area, const int* pixels, int count, orbitCounts* counts, void* context)
+{
+	tileJob& job = *(tileJob*)context;
+	const engineFrame& frame = *job.frame;
+
+	job.renderer(*frame.constants, tileGrid(*frame.grid, area.x, frame.firstRow + area.y, area.width), pixels, count, counts, &job.lanes);
+}
+
+// Working arrays of the tile a thread is on, whichever frame it is of. They
+// only grow, so tiles after a thread's first allocate nothing.
+struct tileScratch
+{
+	vector<orbitCounts> counts;
+	vector<colorRGB> colors;
+	vector<unsigned char> missing;
+	vector<unsigned char> skipped;
+};
+
+static thread_local tileScratch threadScratch;
+
+// Iterates the layers of the tile's pixels on the stride lattice that the
+// target doesn't know yet, then colors the whole tile. Pixels missing the
+// same layers go to that layer's renderer together.
+static void renderTile(const tile& area, void* context)
+{
+	engineFrame& frame = *(engineFrame*)context;
+	const rowTarget& target = *frame.target;
+	if(target.cancelled != NULL && target.cancelled(target.context))
+		return;
+
+	const int layers = frame.layers;
+	const int stride = target.stride;
+	const int pixelCount = area.width * area.height;
+	tileScratch& scratch = threadScratch;
+	vector<orbitCounts>& counts = scratch.counts;
+	vector<colorRGB>& colors = scratch.colors;
+	vector<unsigned char>& missing = scratch.missing;
+	vector<unsigned char>& skipped = scratch.skipped;
+	counts.resize(pixelCount);
+	colors.resize(pixelCount);
+	missing.resize(pixelCount);
+	skipped.resize(pixelCount);
+
+	int missingSets = 0;
+	int computed = 0;
+	for(int y = 0; y < area.height; y++)
+	{
+		for(int x = 0; x < area.width; x++)
+		{
+			size_t pixel = size_t(area.y + y) * frame.width + area.x + x;
+			bool onPass = (area.x + x) % stride == 0 && (area.y + y) % stride == 0;
+			int have = target.known != NULL ? target.known[pixel] : 0;
+			missing[y * area.width + x] = onPass ? layers & ~have : 0;
+			missingSets |= 1 << missing[y * area.width + x];
+			computed |= missing[y * area.width + x];
+		}
+	}
+
+	tileJob job;
+	job.frame = &frame;
+	job.lanes.usedLanes = 0;
+	job.lanes.totalLanes = 0;
+	for(int set = 1; set <= layers; set++)
+	{
+		if((missingSets & (1 << set)) == 0)
+			continue;
+		job.renderer = frame.renderers[set];
+		if(missingSets == 1 << layers && frame.subdivide)
+			frame.computedPixels += subdivideTile(area, iteratePixels, &job, &counts[0]);
+		else if(missingSets == 1 << layers)
+			frame.computedPixels += bruteForceTile(area, iteratePixels, &job, &counts[0]);
+		else
+		{
+			for(int i = 0; i < pixelCount; i++)
+				skipped[i] = missing[i] != set;
+			frame.computedPixels += completeTile(area, &skipped[0], iteratePixels, &job, &counts[0]);
+		}
+	}
+	frame.statistics.add(job.lanes);
+	frame.computedLayers |= computed;
+
+	for(int y = 0; y < area.height && target.counts != NULL; y++)
+	{
+		size_t row = size_t(area.y + y) * frame.width + area.x;
+		for(int x = 0; x < area.width; x++)
+		{
+			const int layer = missing[y * area.width + x];
+			if(layer == 0)
+				continue;
+			if(target.known != NULL)
+			{
+				copyLayers(target.counts[row + x], counts[y * area.width + x], layer);
+				target.known[row + x] |= layer;
+			}
+			else
+				target.counts[row + x] = counts[y * area.width + x];
+		}
+	}
+
+	if(target.pixels == NULL)
+		return;
+
+	// pixels the target keeps counts for show what it has, or the corner of
+	// their stride block until it has them
+	for(int y = 0; y < area.height && target.known != NULL; y++)
+	{
+		int rowY = area.y + y;
+		size_t row = size_t(rowY) * frame.width;
+		size_t sampleRow = size_t(rowY - rowY % stride) * frame.width;
+		for(int x = 0; x < area.width; x++)
+		{
+			int pixelX = area.x + x;
+			bool complete = (target.known[row + pixelX] & layers) == layers;
+			counts[y * area.width + x] = target.counts[complete ? row + pixelX : sampleRow + pixelX - pixelX % stride];
+		}
+	}
+	frame.colors(&counts[0], pixelCount, *frame.palette, &colors[0]);
+
+	const int bytes = target.alpha ? 4 : 3;
+	bool changed = false;
+	for(int y = 0; y < area.height; y++)
+	{
+		unsigned char* pixel = target.pixels + (size_t(area.y + y) * frame.width + area.x) * bytes;
+		for(int x = 0; x < area.width; x++, pixel += bytes)
+		{
+			const colorRGB& color = colors[y * area.width + x];
+			const unsigned char red = toByte(color.red);
+			const unsigned char green = toByte(color.green);
+			const unsigned char blue = toByte(color.blue);
+			changed = changed || pixel[0] != red || pixel[1] != green || pixel[2] != blue || (target.alpha && pixel[3] != 255);
+			pixel[0] = red;
+			pixel[1] = green;
+			pixel[2] = blue;
+			if(target.alpha)
+				pixel[3] = 255;
+		}
+	}
+	if(changed && target.changed != NULL)
+		target.changed(area, target.context);
+}
+
+// True if b iterates the same points the same way as a
+static bool sameKernels(const frameRequest& a, const frameRequest& b)
+{
+	return a.fractal == b.fractal && a.juliaConstant == b.juliaConstant && a.scale == b.scale
+		&& a.width == b.width && a.height == b.height && a.maxIterations == b.maxIterations
+		&& a.coordinates == b.coordinates && a.isa == b.isa && a.mode == b.mode && a.precision == b.precision
+		&& (a.centerX - b.centerX).toDouble() == 0.0 && (a.centerY - b.centerY).toDouble() == 0.0;
+}
+
+frameRenderer::frameRenderer() : kernelsReady(false), referenceSeconds(0.0)
+{
+}
+
+void frameRenderer::prepareKernels(const frameRequest& request)
+{
+	if(kernelsReady && sameKernels(prepared, request))
+		return;
+
+	const int layers = layersOf(request.fractal);
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	if(request.coordinates == DoubleCoordinates)
+	{
+		viewport view = {request.centerX.toDouble(), request.centerY.toDouble(), request.scale, request.width, request.height};
+		// float counts stop being exact past 2^24 iterations
+		const precisionType precision = request.maxIterations > (1 << 24) ? DoublePrecision : request.precision;
+		grid = viewportGrid(view);
+		renderers[juliaLayer] = selectPointRenderer(request.isa, request.mode, precision, Julia);
+		renderers[mandelbrotLayer] = selectPointRenderer(request.isa, request.mode, precision, Mandelbrot);
+		renderers[layers] = selectPointRenderer(request.isa, request.mode, precision, request.fractal);
+		constants.juliaRe = request.juliaConstant.real();
+		constants.juliaIm = request.juliaConstant.imag();
+		constants.maxIterations = request.maxIterations;
+		constants.center = NULL;
+		constants.juliaReference = NULL;
+		constants.mandelbrotReference = NULL;
+	}
+	else
+	{
+		deepView view = {request.centerX, request.centerY, request.scale, request.width, request.height};
+		prepareDeepFrame(deep, view, request.coordinates, request.fractal, request.juliaConstant, request.maxIterations, request.isa, request.mode);
+		grid = deep.grid;
+		constants = deep.constants;
+		renderers[layers] = deep.renderer;
+		// Mixed and Greater frames have references of both layers
+		if(layers != juliaLayer && layers != mandelbrotLayer)
+		{
+			renderers[juliaLayer] = deepPointRenderer(deep, Julia);
+			renderers[mandelbrotLayer] = deepPointRenderer(deep, Mandelbrot);
+		}
+	}
+	referenceSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	prepared = request;
+	kernelsReady = true;
+}
+
+void frameRenderer::renderRows(tileScheduler& scheduler, const frameRequest& request, int firstRow, int rowCount, const rowTarget& target, frameReport& report)
+{
+	const int layers = layersOf(request.fractal);
+	preparePalette(palette, request.colorType, request.maxIterations);
+
+	// the kernels are only prepared for frames that have pixels to iterate
+	bool iterate = target.known == NULL;
+	for(int y = 0; y < rowCount && !iterate; y += target.stride)
+	{
+		const unsigned char* known = target.known + size_t(y) * request.width;
+		for(int x = 0; x < request.width && !iterate; x += target.stride)
+			iterate = (known[x] & layers) != layers;
+	}
+	report.referenceBits = 0;
+	report.referencePoints = 0;
+	report.skippedIterations = 0;
+	report.referenceSeconds = 0.0;
+	if(iterate)
+	{
+		const bool reused = kernelsReady && sameKernels(prepared, request);
+		prepareKernels(request);
+		report.referenceSeconds = reused ? 0.0 : referenceSeconds;
+		if(request.coordinates == PerturbationCoordinates)
+		{
+			const perturbationReference& reference = request.fractal == Julia ? deep.julia : deep.mandelbrot;
+			report.referenceBits = deep.referenceWords * 32;
+			report.referencePoints = reference.orbitRe.size();
+			report.skippedIterations = reference.skipped;
+		}
+	}
+
+	engineFrame frame;
+	frame.grid = &grid;
+	frame.renderers = renderers;
+	frame.constants = &constants;
+	frame.layers = layers;
+	frame.colors = selectColorFunction(request.fractal);
+	frame.palette = &palette;
+	frame.subdivide = request.subdivide;
+	frame.width = request.width;
+	frame.firstRow = firstRow;
+	frame.target = &target;
+	frame.computedPixels = 0;
+	frame.computedLayers = 0;
+
+	chrono::steady_clock::time_point start = chrono::steady_clock::now();
+	scheduler.run(request.width, rowCount, request.tileSize, renderTile, &frame);
+
+	report.renderSeconds = chrono::duration<double>(chrono::steady_clock::now() - start).count();
+	report.utilisation = frame.statistics.utilisation();
+	report.lanes.usedLanes = frame.statistics.usedLanes;
+	report.lanes.totalLanes = frame.statistics.totalLanes;
+	report.computedPixels = frame.computedPixels;
+	report.computedLayers = frame.computedLayers;
+}
+
+void renderFrame(tileScheduler& scheduler, const frameRequest& request, unsigned char* pixels, orbitCounts* counts, frameReport& report)
+{
+	renderRows(scheduler, request, 0, request.height, pixels, counts, report);
+}
+
+void renderRows(tileScheduler& scheduler, const frameRequest& request, int firstRow, int rowCount, unsigned char* pixels, orbitCounts* counts, frameReport& report)
+{
+	frameRenderer renderer;
+	rowTarget target;
+	target.pixels = pixels;
+	target.counts = counts;
+	renderer.renderRows(scheduler, request, firstRow, rowCount, target, report);
+}
@@ -0,0 +1,143 @@
+// FractalEngine.h
+// Renders whole frames as one call, for programs that render many of them:
+// everything a frame depends on is in a frameRequest, which is only read,
+// and the results go to buffers the caller owns. No global settings are
+// read, so any number of threads can render at once. They can share one
+// tileScheduler, whose run() lets concurrent frames share its workers.
+
+#pragma once
+
+#include "BigFloat.h"
+#include "DeepZoom.h"
+#include "EscapeKernel.h"
+#include "TileScheduler.h"
+
+#include <complex>
+
+struct frameRequest
+{
+	fractalType fractal;
+	colorSet colorType;
+	std::complex<double> juliaConstant;
+	// at whatever precision the caller has; double frames round it to double
+	bigFloat centerX;
+	bigFloat centerY;
+	// distance from the center to the left edge
+	double scale;
+	int width;
+	int height;
+	int maxIterations;
+	// coordinatesFor() (DeepZoom.h) gives the cheapest that resolve the pixels
+	coordinateType coordinates;
+	// the caller checks that the CPU supports isa
+	instructionSet isa;
+	kernelMode mode;
+	// of double frames; deeper coordinates have their own
+	precisionType precision;
+	bool subdivide;
+	// 0 picks one per frame
+	int tileSize;
+};
+
+// What rendering a frame took
+struct frameReport
+{
+	double utilisation;
+	// whose ratio utilisation is, to add up the bands of a frame
+	laneStatistics lanes;
+	long long computedPixels;
+	// the layers (layersOf()) some pixel was iterated for
+	int computedLayers;
+	// the perturbation reference orbit of the fractal type, 0 for other coordinates
+	int referenceBits;
+	size_t referencePoints;
+	int skippedIterations;
+	// preparing the coordinates (the reference orbits), then the pixels
+	double referenceSeconds;
+	double renderSeconds;
+};
+
+// The Julia and Mandelbrot counts of a pixel are layers that are known or not
+// on their own: Mixed and Greater need both, Julia and Mandelbrot one. The
+// Mandelbrot layer doesn't depend on the Julia constant.
+const int juliaLayer = 1;
+const int mandelbrotLayer = 2;
+
+int layersOf(fractalType fractal);
+void copyLayers(orbitCounts& to, const orbitCounts& from, int layers);
+
+// Where frameRenderer::renderRows() puts its rows, in buffers that hold just
+// those rows. Only pixels is needed to render a picture; the rest lets
+// interactive programs keep counts between frames and show them coarse to
+// fine.
+struct rowTarget
+{
+	// RGB triples, or RGBA with alpha 255 if alpha is set; NULL only computes
+	// counts
+	unsigned char* pixels;
+	bool alpha;
+	// the iteration counts of the pixels, or NULL
+	orbitCounts* counts;
+	// Unless NULL, the layers counts already holds for each pixel. Only the
+	// missing ones are iterated, and known gets them once they are.
+	unsigned char* known;
+	// Of those, only pixels on every stride-th row and column are iterated;
+	// the others are colored like the pixel at the corner of their stride
+	// block until known has them. Tiles have to be a multiple of stride in
+	// size, which tileSize 0 gives for strides up to 8.
+	int stride;
+	// Asked before every tile; once it says true the remaining tiles are
+	// skipped and their pixels stay as they were
+	bool (*cancelled)(void* context);
+	// Told about every tile whose pixels changed, on the scheduler's threads
+	void (*changed)(const tile& area, void* context);
+	void* context;
+
+	rowTarget() : pixels(NULL), alpha(false), counts(NULL), known(NULL), stride(1), cancelled(NULL), changed(NULL), context(NULL) {}
+};
+
+// Renders frames while keeping what they have in common: the palette, and the
+// kernels, pixel grid and reference orbits of the last request that had
+// pixels to iterate, until a request needs different ones. Rendering a frame
+// in several calls (bands, passes) through one frameRenderer prepares it
+// once. A frameRenderer renders one call at a time; use one per thread.
+class frameRenderer
+{
+public:
+	frameRenderer();
+
+	// Renders rows firstRow to firstRow + rowCount - 1 of request into target
+	void renderRows(tileScheduler& scheduler, const frameRequest& request, int firstRow, int rowCount, const rowTarget& target, frameReport& report);
+
+private:
+	void prepareKernels(const frameRequest& request);
+
+	colorPalette palette;
+	bool kernelsReady;
+	// what the kernels were prepared for
+	frameRequest prepared;
+	double referenceSeconds;
+	pixelGrid grid;
+	orbitConstants constants;
+	// by the layers they compute, so pixels that have one layer already only
+	// iterate the other
+	pointRenderer renderers[4];
+	// constants points into it, so it stays put
+	deepFrame deep;
+
+	frameRenderer(const frameRenderer&);
+	frameRenderer& operator=(const frameRenderer&);
+};
+
+// Renders request on scheduler. pixels receives width * height RGB triples
+// row by row; counts, unless it is NULL, the iteration counts of the pixels
+// in the same order.
+void renderFrame(tileScheduler& scheduler, const frameRequest& request, unsigned char* pixels, orbitCounts* counts, frameReport& report);
+
+// Renders rows firstRow to firstRow + rowCount - 1 of the frame, exactly as
+// renderFrame() would, into buffers that hold just those rows. Frames too
+// large for memory can be rendered a band at a time this way; every call
+// prepares the coordinates again, so keep a frameRenderer for the bands
+// instead when they are only a few rows. With subdivide, bands that start on
+// a multiple of a fixed tileSize match the whole frame.
+void renderRows(tileScheduler& scheduler, const frameRequest& request, int firstRow, int rowCount, unsigned char* pixels, orbitCounts* counts, frameReport& report);
@@ -0,0 +1,268 @@
+// FractalPolicies.h
+// Policy types that the kernel templates are specialized on. A formula says
+// how a pixel starts its orbit, a fractal says which formulas are iterated
+// and how their colors combine, a coloring maps an iteration count to RGB.
+// Kernels only iterate; colors come from a separate pass over the counts.
+// Adding a formula means one small struct here plus a line in
+// fillFractals() (PointRenderer.h).
+//
+// Like SimdKernel.h this is included by every kernel translation unit after
+// its instruction set is enabled, so it all lives in an unnamed namespace.
+
+#pragma once
+
+namespace {
+
+// --- formulas: z -> z^2 + c started from a pixel (x, y) ---
+// interior() may return true for pixels whose orbit provably never escapes;
+// the loops count those as maxIterations without iterating. For perturbation
+// (DeepZoom.cpp) a formula names its reference orbit and whether the pixel's
+// offset is added on every step (Mandelbrot) or only starts the orbit (Julia).
+
+struct juliaFormula
+{
+	template<class real>
+	static void start(real x, real y, const orbitConstants& constants, real& zRe, real& zIm, real& cRe, real& cIm)
+	{
+		zRe = x;
+		zIm = y;
+		cRe = real(constants.juliaRe);
+		cIm = real(constants.juliaIm);
+	}
+
+	template<class real>
+	static bool interior(real /*x*/, real /*y*/)
+	{
+		return false;
+	}
+
+	enum { addsPixel = false };
+
+	static const perturbationReference& reference(const orbitConstants& constants)
+	{
+		return *constants.juliaReference;
+	}
+
+	static int count(const orbitCounts& counts)
+	{
+		return counts.julia;
+	}
+
+	static orbitCounts counts(int iterations)
+	{
+		orbitCounts result = {iterations, 0};
+		return result;
+	}
+};
+
+struct mandelbrotFormula
+{
+	template<class real>
+	static void start(real x, real y, const orbitConstants& /*constants*/, real& zRe, real& zIm, real& cRe, real& cIm)
+	{
+		zRe = real(0);
+		zIm = real(0);
+		cRe = x;
+		cIm = y;
+	}
+
+	// main cardioid and period-2 bulb; strict tests keep boundary pixels iterating
+	template<class real>
+	static bool interior(real x, real y)
+	{
+		real shifted = x - real(0.25);
+		real q = shifted * shifted + y * y;
+		if(q * (q + shifted) < real(0.25) * y * y)
+			return true;
+		return (x + real(1)) * (x + real(1)) + y * y < real(0.0625);
+	}
+
+	enum { addsPixel = true };
+
+	static const perturbationReference& reference(const orbitConstants& constants)
+	{
+		return *constants.mandelbrotReference;
+	}
+
+	static int count(const orbitCounts& counts)
+	{
+		return counts.mandelbrot;
+	}
+
+	static orbitCounts counts(int iterations)
+	{
+		orbitCounts result = {0, iterations};
+		return result;
+	}
+};
+
+// --- colorings: iteration count -> color, with per-frame constants in palette;
+// preparePalette() runs them once per count rather than once per pixel ---
+
+// based on hsv scale at http://basecase.org/2011/12/hsv
+struct hsvColoring
+{
+	struct palette
+	{
+		double milestone;
+	};
+
+	static palette prepare(int maxIterations)
+	{
+		palette setup;
+		setup.milestone = maxIterations/6;
+		return setup;
+	}
+
+	static colorRGB color(int count, const palette& setup)
+	{
+		double iterations = count;
+		double milestone = setup.milestone;
+		double ratio = iterations / milestone;	// percentage of progress between milestones in HSV wheel
+		double red = 0;
+		double green = 0;
+		double blue = 0;
+
+		if ( iterations < milestone )
+		{
+			red = 1.0;
+			green = ratio;
+		}
+		else if ( iterations < (milestone*2) )
+		{
+			red = 1.0 - ratio;
+			green = 1.0;
+		}
+		else if ( iterations < (milestone*3) )
+		{
+			green = 1.0;
+			blue = ratio;
+		}
+		else if ( iterations < (milestone*4) )
+		{
+			green = 1.0 - ratio;
+			blue = 1.0;
+		}
+		else if ( iterations < (milestone*5) )
+		{
+			red = ratio;
+			blue = 1.0;
+		}
+		else if (iterations < (milestone*6) )
+		{
+			red = 1.0;
+			blue = 1.0 - ratio;
+		}
+		else if (iterations == 255)
+			red = 1.0;
+
+		colorRGB result = {float(red), float(green), float(blue)};
+		return result;
+	}
+};
+
+// Spreads the count over a 24 bit RGB value; with a shift above 24 the top
+// bits wrap around and the palette repeats
+template<int shift>
+struct rgbColoring
+{
+	struct palette
+	{
+		double LSB;
+	};
+
+	static palette prepare(int maxIterations)
+	{
+		palette setup;
+		setup.LSB = maxIterations / double(1<<shift);
+		return setup;
+	}
+
+	static colorRGB color(int count, const palette& setup)
+	{
+		unsigned int value = (unsigned int)(count / setup.LSB);
+
+		colorRGB result = {
+			float(((value >> 16) & 0xff) / 255.0),
+			float(((value >> 8) & 0xff) / 255.0),
+			float((value & 0xff) / 255.0)};
+		return result;
+	}
+};
+
+// --- fractals: which formulas run per pixel and how their colors combine ---
+
+template<class formula>
+struct singleFractal
+{
+	template<class loop, class real>
+	static void iterate(const real* re, const real* im, int count, const orbitConstants& constants, int* iterations, int* /*scratch*/, orbitCounts* counts, laneStatistics* statistics)
+	{
+		loop::template run<formula>(re, im, count, constants, iterations, statistics);
+		for(int i = 0; i < count; i++)
+			counts[i] = formula::counts(iterations[i]);
+	}
+
+	// palette is a color table or anything else indexed by iteration count
+	template<class lookup>
+	static colorRGB color(const orbitCounts& counts, const lookup& palette)
+	{
+		return palette[formula::count(counts)];
+	}
+};
+
+// Julia and Mandelbrot layers of the same points, combined per channel. The
+// loops iterate both layers in one pass (runPair).
+template<class blend>
+struct blendedFractal
+{
+	template<class loop, class real>
+	static void iterate(const real* re, const real* im, int count, const orbitConstants& constants, int* juliaIterations, int* mandelbrotIterations, orbitCounts* counts, laneStatistics* statistics)
+	{
+		loop::template runPair<juliaFormula, mandelbrotFormula>(re, im, count, constants, juliaIterations, mandelbrotIterations, statistics);
+		for(int i = 0; i < count; i++)
+		{
+			counts[i].julia = juliaIterations[i];
+			counts[i].mandelbrot = mandelbrotIterations[i];
+		}
+	}
+
+	template<class lookup>
+	static colorRGB color(const orbitCounts& counts, const lookup& palette)
+	{
+		return blend::combine(palette[counts.julia], palette[counts.mandelbrot]);
+	}
+};
+
+struct addedBlend
+{
+	static float channel(float julia, float mandelbrot)
+	{
+		float mixed = julia + mandelbrot;
+		while(mixed > 1.0)
+			mixed -= 1.0;
+		return mixed;
+	}
+
+	static colorRGB combine(const colorRGB& julia, const colorRGB& mandelbrot)
+	{
+		colorRGB mixed = {channel(julia.red, mandelbrot.red), channel(julia.green, mandelbrot.green), channel(julia.blue, mandelbrot.blue)};
+		return mixed;
+	}
+};
+
+struct greaterBlend
+{
+	static float channel(float julia, float mandelbrot)
+	{
+		return julia > mandelbrot ? julia : mandelbrot;
+	}
+
+	static colorRGB combine(const colorRGB& julia, const colorRGB& mandelbrot)
+	{
+		colorRGB mixed = {channel(julia.red, mandelbrot.red), channel(julia.green, mandelbrot.green), channel(julia.blue, mandelbrot.blue)};
+		return mixed;
+	}
+};
+
+}
@@ -1,7 +1,24 @@
 #include "Angel.h"
 #include "vec.h"
 #include "mat.h"
+#include "FractalCore.h"
+#include "DeepZoom.h"
+#include "DiskCache.h"
+#include "EscapeKernel.h"
+#include "FractalEngine.h"
+#include "FrameBuffers.h"
+#include "TileScheduler.h"
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cmath>
 #include <complex>
+#include <condition_variable>
+#include <limits>
+#include <mutex>
+#include <sstream>
+#include <thread>
+#include <vector>
 
 using namespace std;
 using namespace Angel;
@@ -10,405 +27,1024 @@ GLuint WIDTH_PIXELS = 500;
 GLuint HEIGHT_PIXELS = 500;
 int height = (int)WIDTH_PIXELS;
 int width = (int)HEIGHT_PIXELS;
-size_t totalPoints = height * width;
-vec2 * pointArray;
-vec3 * colorArray;
-vec3 translateToColor(double);
+size_t totalPoints = size_t(height) * width;
 int maxIterations = 100;
 
-enum fractalType{Julia, Mandelbrot, Mixed, Greater};
 enum fractalType fractal = Julia;
-string fractalTypeArray[4] = {"Julia", "Mandelbrot", "Mixed - Added", "Mixed - Greater"};
 
-enum colorSet{HSV, RGB, RGBShift};
 enum colorSet colorType = HSV;
-string colorSetArray[3] = {"HSV", "RGB shifted 23", "RGB shifted 25"};
 
 enum juliaSet{first, second, third, fourth, fifth, sixth, seventh, eighth, ninth, tenth, eleventh, twelth};
 enum juliaSet juliaNumber = first;
 
-complex<double> juliaSetArray [12] = {
-	complex<double>(-0.8, 0.156),
-	complex<double>(-0.4, 0.6),
-	complex<double>(-.62772, .42193),
-	complex<double>(0.3515, -0.07467),
-	complex<double>(-0.391, -0.587),
-	complex<double>(0.233, 0.53780),
-	complex<double>(-0.74543, 0.11301),
-	complex<double>(-0.74434, -0.10722),
-	complex<double>(0.285, 0.01),
-	complex<double>(0.45, 0.1428),
-	complex<double>(-0.70176, -0.3842),
-	complex<double>(-0.835, -0.2321)
+complex<double> juliaConstant;
+
+tileScheduler * scheduler;
+
+// the kernels frames run on: the widest the CPU supports, streaming, in
+// double precision
+const instructionSet frameIsa = detectInstructionSet();
+const kernelMode frameMode = StreamingKernel;
+const precisionType framePrecision = DoublePrecision;
+
+// finished layers of earlier runs, so views rendered before load instead of
+// iterating
+diskCache * layerStore;
+const char* const layerStoreDirectory = "FractalCache";
+const size_t layerStoreBudget = (size_t)256 << 20;
+
+bool subdivide = false;
+
+// Progressive frames are computed in passes over every 4th pixel of every 4th
+// row, then every 2nd, then the rest, and each pass is shown when it is done.
+// Until then a pixel shows the one at the corner of its stride block.
+// Subdivided frames are computed in one pass.
+bool progressive = true;
+const int passStrides[3] = {4, 2, 1};
+
+// where a frame's pixels are: the center pixel at full precision and the
+// scale, as in viewport
+struct framePosition
+{
+	bigFloat centerX;
+	bigFloat centerY;
+	double scale;
 };
 
-complex<double> juliaConstant = juliaSetArray[juliaNumber];
+// the view the input callbacks work on
+framePosition view;
 
-double zoomLevel = 1.0;
+// Where zooming in on location ([-1,1] across the window) leads from from:
+// the pixel there becomes the center and the scale halves
+framePosition zoomedIn(const framePosition& from, vec2 location)
+{
+	framePosition to = from;
+	int words = bigFloat::wordsFor(from.scale / 2 / (width / 2.0));
+	int pixelX = (int)floor(location.x * (width / 2.0) + 0.5);
+	int pixelY = (int)floor(location.y * (height / 2.0) + 0.5);
+	to.centerX.setPrecision(words);
+	to.centerY.setPrecision(words);
+	to.centerX = to.centerX + bigFloat(pixelX * (from.scale / (width / 2.0)), words);
+	to.centerY = to.centerY + bigFloat(pixelY * (from.scale / (height / 2.0)), words);
+	to.scale = from.scale / 2;
+	return to;
+}
 
-void generatePointArray()
+// views zoomed in from, the most recent last; zooming out pops them
+vector<framePosition> zoomHistory;
+const size_t zoomHistoryLength = 8;
+
+// Frames are rendered on their own thread, so the input callbacks only
+// describe the frame they want and return. Every request bumps
+// requestGeneration, and tiles of a frame that is no longer the latest
+// return without computing anything, so a new request waits for at most
+// one tile of the old one.
+struct renderRequest
 {
-	int currentX = 0;
-	int currentY = 0;
-	double scaleX = width / 2.0;
-	double scaleY = height / 2.0;
-	double x;
-	double y;
+	framePosition position;
+	fractalType fractal;
+	colorSet colorType;
+	complex<double> juliaConstant;
+	int maxIterations;
+	bool subdivide;
+	bool progressive;
+	// start over instead of reusing the frames in memory, and print when done
+	bool fresh;
+	bool report;
+};
 
-	pointArray = new vec2[totalPoints];
+mutex requestLock;
+condition_variable requestReady;
+renderRequest pendingRequest;
+bool requestPending = false;
+bool stopRendering = false;
+// the render thread is idle and may speculate, and where the mouse rests
+// ([-1,1] across the window) if it does over the window
+bool speculationPending = false;
+bool hovering = false;
+vec2 hoverLocation;
+atomic<unsigned int> requestGeneration(0);
+thread renderThread;
+
+// Every allocation from FrameBuffers.h and, in builds with
+// FRACTAL_COUNT_ALLOCATIONS defined, through new, so -selftest can check that
+// rendering a frame makes none once the buffers have been allocated. Other
+// builds keep the standard operator new.
+#ifdef FRACTAL_COUNT_ALLOCATIONS
+atomic<long long> heapAllocations(0);
+
+void* operator new(size_t bytes)
+{
+	++heapAllocations;
+	void* memory = malloc(bytes > 0 ? bytes : 1);
+	if(memory == NULL)
+		throw bad_alloc();
+	return memory;
+}
 
-	for(int i = 0; i < totalPoints; i++)
-	{
+void operator delete(void* memory) noexcept
+{
+	free(memory);
+}
 
-		x = (currentX - (width/2)) / scaleX;
-		y = ((-currentY) + (height/2)) / scaleY;
+long long allocationCount()
+{
+	return heapAllocations + frameAllocations();
+}
+#else
+long long allocationCount()
+{
+	return frameAllocations();
+}
+#endif
 
-		if(currentX + 1 == width)
-		{
-			++currentY;
-			currentX = 0;
-		}
-		else
-			++currentX;
-		
-		pointArray[i] = vec2(x, y);
-	}
+// a pixel as the display texture holds it
+struct pixelRGBA8
+{
+	GLubyte red;
+	GLubyte green;
+	GLubyte blue;
+	GLubyte alpha;
+};
+
+bool sameColor(const pixelRGBA8& a, const pixelRGBA8& b)
+{
+	return a.red == b.red && a.green == b.green && a.blue == b.blue && a.alpha == b.alpha;
 }
 
+// the colors of the last pass the render thread finished, and the tiles of
+// them that changed since the GLUT thread last uploaded them
+mutex colorsLock;
+frameVector<pixelRGBA8> finishedColors;
+vector<tile> finishedTiles;
+size_t finishedArea = 0;
+bool colorsFinished = false;
+// allocations the frame made up to the pass in finishedColors
+long long renderAllocations = 0;
+// generation of the last frame whose speculation ran to the end, and the
+// allocations that speculation made
+atomic<unsigned int> speculationGeneration(0);
+atomic<long long> speculationAllocations(0);
+
+// --- everything below up to display() belongs to the render thread ---
+
+renderRequest frame;
+unsigned int frameGeneration = 0;
+bool haveFrame = false;
+long long frameStartAllocations = 0;
+frameVector<pixelRGBA8> colorArray;
+// tiles whose colors the current pass changed
+mutex dirtyLock;
+vector<tile> dirtyTiles;
+// iteration counts of the frame, so changing colors doesn't iterate again
+frameVector<orbitCounts> countArray;
+
+// Renders the frame's passes, keeping its palette and kernels (the reference
+// orbits of deep zooms) from one pass and frame to the next while they last.
+// request is the frame as the engine takes it.
+frameRenderer engine;
+frameRequest request;
+
+// what rendering the frame took, over all passes
+frameStatistics laneUsage;
+long long computedPixels = 0;
+
+// layers the frame iterated some pixels of, and those it loaded from layerStore
+int computedLayers = 0;
+int loadedLayers = 0;
+
+// a frame's counts, which of their layers are done and what they were
+// rendered for, kept for later frames to reuse. Subdivided counts can be
+// filled over thin filaments, so exact frames never take them.
+struct storedFrame
+{
+	framePosition position;
+	complex<double> juliaConstant;
+	int maxIterations;
+	bool subdivide;
+	frameVector<orbitCounts> counts;
+	frameVector<unsigned char> known;
+};
+
+// recent frames of any fractal type, the most recent last
+vector<storedFrame> frameCache;
+const size_t frameCacheLength = 9;
 
+// frames rendered ahead of the input that would ask for them (speculate())
+vector<storedFrame> speculativeFrames;
 
-double recursiveColor(complex<double> complexNum, complex<double> constant, int iterations)
+// Buffers of frames the caches dropped, for the next frames they store. Every
+// frame buffer is allocated once and then moves between countArray, the
+// caches and here, so rendering doesn't allocate.
+vector<storedFrame> spareFrames;
+
+// gives stored counts and known buffers for a whole frame
+void takeFrame(storedFrame& stored)
 {
-	if(iterations == maxIterations)
-		return double(iterations);
-	if(sqrt(complexNum.real() * complexNum.real() + complexNum.imag() * complexNum.imag()) > 2)
-		return double(iterations);
-	else
+	if(spareFrames.empty())
 	{
-		complexNum = complex<double>(complexNum.real() * complexNum.real() - (complexNum.imag() * complexNum.imag()) + constant.real(), 2 * complexNum.real() * complexNum.imag() + constant.imag());
-		return recursiveColor(complexNum, constant, ++iterations);
+		stored.counts.resize(totalPoints);
+		stored.known.resize(totalPoints);
+		return;
 	}
+	stored.counts.swap(spareFrames.back().counts);
+	stored.known.swap(spareFrames.back().known);
+	spareFrames.pop_back();
 }
 
-void generateColorArray()
+// keeps the buffers of stored, which is about to be dropped, for takeFrame()
+void dropFrame(storedFrame& stored)
 {
-	double iterations;
+	spareFrames.push_back(storedFrame());
+	spareFrames.back().counts.swap(stored.counts);
+	spareFrames.back().known.swap(stored.known);
+}
 
-	colorArray = new vec3[totalPoints];
+// layers of countArray that are done, taken from earlier frames or computed
+// by an earlier pass; renderPass() only computes the missing ones
+frameVector<unsigned char> knownLayers;
 
-	if(fractal == 0)
-	{	
-		for(int i = 0; i < totalPoints; i++)
-		{	
-			iterations = 0;
+bool knownPixel(size_t pixel)
+{
+	const int layers = layersOf(frame.fractal);
+	return (knownLayers[pixel] & layers) == layers;
+}
 
-			complex<double> constantComplex = juliaConstant;
-			complex<double> complexNum = complex<double>(pointArray[i].x, pointArray[i].y);
+// fills in request for the frame
+void describeFrame()
+{
+	request.fractal = frame.fractal;
+	request.colorType = frame.colorType;
+	request.juliaConstant = frame.juliaConstant;
+	request.centerX = frame.position.centerX;
+	request.centerY = frame.position.centerY;
+	request.scale = frame.position.scale;
+	request.width = width;
+	request.height = height;
+	request.maxIterations = frame.maxIterations;
+	request.coordinates = coordinatesFor(frame.position.scale / (width / 2.0));
+	request.isa = frameIsa;
+	request.mode = frameMode;
+	request.precision = framePrecision;
+	request.subdivide = frame.subdivide;
+	request.tileSize = 0;
+}
 
-			iterations = recursiveColor(complexNum, constantComplex, 0);
+// tiles of a frame that is no longer the latest return without computing anything
+bool frameOutdated(void* /*context*/)
+{
+	return requestGeneration != frameGeneration;
+}
 
-			colorArray[i] = translateToColor(iterations);
-		}
-	}
-	else if(fractal == 1)
-	{
-		for(int i = 0; i < totalPoints; i++)
-		{	
-			iterations = 0;
+// keeps the tiles a pass changed the colors of for publishColors()
+void colorsChanged(const tile& area, void* /*context*/)
+{
+	lock_guard<mutex> hold(dirtyLock);
+	dirtyTiles.push_back(area);
+}
 
-			complex<double> constantComplex = complex<double>(pointArray[i].x, pointArray[i].y);
-			complex<double> complexNum = complex<double>(0,0);
+// Computes the layers of the frame's pixels on every stride-th row and
+// column that aren't known yet and, if colored, colors the frame into
+// colorArray from what it has
+void renderPass(int stride, bool colored)
+{
+	describeFrame();
+	rowTarget target;
+	target.pixels = colored ? &colorArray[0].red : NULL;
+	target.alpha = true;
+	target.counts = &countArray[0];
+	target.known = &knownLayers[0];
+	target.stride = stride;
+	target.cancelled = frameOutdated;
+	target.changed = colorsChanged;
+
+	frameReport report;
+	engine.renderRows(*scheduler, request, 0, height, target, report);
+	laneUsage.add(report.lanes);
+	computedPixels += report.computedPixels;
+	computedLayers |= report.computedLayers;
+}
 
-			iterations = recursiveColor(complexNum, constantComplex, 0);
+// whole pixels of size step in offset, if it is that close to a whole number of them
+bool wholePixels(const bigFloat& offset, double step, int& pixels)
+{
+	double exact = offset.toDouble() / step;
+	pixels = (int)floor(exact + 0.5);
+	return fabs(exact - pixels) < 1.0e-3;
+}
 
-			colorArray[i] = translateToColor(iterations);
-		}
-	}
-	else if(fractal == 2)
-	{
-		vec3 juliaColor;
-		vec3 mandelbrotColor;
-		vec3 mixedColor;
+// pixel of a frame step apart whose pixel center is center pixels from the
+// current frame's; pixel * num / den from the center, or -1 if it falls off
+// the frame or between two of its pixels
+int samePixel(int pixel, int center, int shift, int num, int den, int size)
+{
+	int scaled = den * (center + shift) + (pixel - center) * num;
+	if(scaled % den != 0)
+		return -1;
+	scaled /= den;
+	return scaled >= 0 && scaled < size ? scaled : -1;
+}
 
-		for(int i = 0; i < totalPoints; i++)
+// Copies the layers of stored that are still valid into countArray wherever
+// one of its pixels sits on a pixel of the frame and marks them in
+// knownLayers. Zooms change the scale by factors of two and keep the center on
+// a pixel, and pans move it by whole pixels, so the pixel lattices of the two
+// frames line up; returns how many pixels got a layer.
+int reuseFrame(const storedFrame& stored)
+{
+	const framePosition& position = frame.position;
+	const framePosition& old = stored.position;
+
+	if(stored.maxIterations != frame.maxIterations || (stored.subdivide && !frame.subdivide))
+		return 0;
+	const int valid = stored.juliaConstant == frame.juliaConstant ? juliaLayer | mandelbrotLayer : mandelbrotLayer;
+
+	// the frame's step over stored's step: 1/2, 1 or 2
+	int num = position.scale > old.scale ? 2 : 1;
+	int den = position.scale < old.scale ? 2 : 1;
+	if(position.scale * den != old.scale * num)
+		return 0;
+
+	int shiftX, shiftY;
+	if(!wholePixels(position.centerX - old.centerX, old.scale / (width / 2.0), shiftX)
+		|| !wholePixels(old.centerY - position.centerY, old.scale / (height / 2.0), shiftY))
+		return 0;
+
+	int reused = 0;
+	for(int y = 0; y < height; y++)
+	{
+		int oldY = samePixel(y, height / 2, shiftY, num, den, height);
+		if(oldY < 0)
+			continue;
+		for(int x = 0; x < width; x++)
 		{
-			complex<double> constantComplexM = complex<double>(pointArray[i].x, pointArray[i].y);
-			complex<double> complexNumM = complex<double>(0,0);
-			complex<double> complexNumJ = complex<double>(pointArray[i].x, pointArray[i].y);
-			complex<double> constantComplexJ = juliaConstant;
+			int oldX = samePixel(x, width / 2, shiftX, num, den, width);
+			if(oldX < 0)
+				continue;
+			size_t pixel = (size_t)y * width + x;
+			size_t oldPixel = (size_t)oldY * width + oldX;
+			int layers = stored.known[oldPixel] & valid & ~knownLayers[pixel];
+			if(layers == 0)
+				continue;
+			copyLayers(countArray[pixel], stored.counts[oldPixel], layers);
+			knownLayers[pixel] |= layers;
+			++reused;
+		}
+	}
+	return reused;
+}
 
-			mandelbrotColor = translateToColor(recursiveColor(complexNumM, constantComplexM, 0));
+bool samePosition(const framePosition& a, const framePosition& b)
+{
+	return a.scale == b.scale && (a.centerX - b.centerX).toDouble() == 0.0 && (a.centerY - b.centerY).toDouble() == 0.0;
+}
 
- 			juliaColor = translateToColor(recursiveColor(complexNumJ, constantComplexJ, 0));
+// fills the frame with the layers the cached and speculative frames have
+void reuseCaches()
+{
+	for(size_t i = speculativeFrames.size(); i-- > 0; )
+		reuseFrame(speculativeFrames[i]);
+	for(size_t i = frameCache.size(); i-- > 0; )
+		reuseFrame(frameCache[i]);
+}
 
-			for(int i = 0; i < 3; i++)
-			{
-				mixedColor[i] = (juliaColor[i] + mandelbrotColor[i]);
-				while(mixedColor[i] > 1.0)
-					mixedColor[i] -= 1.0;
-			}
+// Makes next the frame and fills it with the layers earlier frames have. A
+// frame of the same view, constant and iterations keeps its layers as they
+// are, so switching fractal types there only computes the missing layers;
+// otherwise the current frame joins the cache first.
+void reuseFrames(const renderRequest& next)
+{
+	if(next.fresh)
+	{
+		for(size_t i = 0; i < frameCache.size(); i++)
+			dropFrame(frameCache[i]);
+		for(size_t i = 0; i < speculativeFrames.size(); i++)
+			dropFrame(speculativeFrames[i]);
+		frameCache.clear();
+		speculativeFrames.clear();
+	}
+	bool sameLayers = haveFrame && !next.fresh && samePosition(next.position, frame.position)
+		&& next.juliaConstant == frame.juliaConstant && next.maxIterations == frame.maxIterations
+		&& (next.subdivide || !frame.subdivide);
 
-			colorArray[i] = mixedColor;
+	if(haveFrame && !next.fresh && !sameLayers)
+	{
+		if(frameCache.size() == frameCacheLength)
+		{
+			dropFrame(frameCache.front());
+			frameCache.erase(frameCache.begin());
 		}
+		frameCache.push_back(storedFrame());
+		storedFrame& current = frameCache.back();
+		current.position = frame.position;
+		current.juliaConstant = frame.juliaConstant;
+		current.maxIterations = frame.maxIterations;
+		current.subdivide = frame.subdivide;
+		takeFrame(current);
+		copy(countArray.begin(), countArray.end(), current.counts.begin());
+		copy(knownLayers.begin(), knownLayers.end(), current.known.begin());
 	}
-	else
-	{
-		vec3 juliaColor;
-		vec3 mandelbrotColor;
-		vec3 mixedColor;
 
-		for(int i = 0; i < totalPoints; i++)
-		{
-			complex<double> constantComplexM = complex<double>(pointArray[i].x, pointArray[i].y);
-			complex<double> complexNumM = complex<double>(0,0);
-			complex<double> complexNumJ = complex<double>(pointArray[i].x, pointArray[i].y);
-			complex<double> constantComplexJ = juliaConstant;
+	frame = next;
+	if(sameLayers)
+		return;
 
-			mandelbrotColor = translateToColor(recursiveColor(complexNumM, constantComplexM, 0));
+	knownLayers.assign(totalPoints, 0);
+	reuseCaches();
+}
 
- 			juliaColor = translateToColor(recursiveColor(complexNumJ, constantComplexJ, 0));
+// one layer of the frame on its way to or from layerStore
+frameVector<int> layerCounts;
 
-			for(int i = 0; i < 3; i++)
-			{
-				if(juliaColor[i] > mandelbrotColor[i])
-					mixedColor[i] = juliaColor[i];
-				else
-					mixedColor[i] = mandelbrotColor[i];
-			}
+// Everything one layer of the frame depends on. Counts are the same on every
+// instruction set and kernel mode, but not in every precision, and subdivided
+// ones are only approximate.
+string layerKey(int layer, bool subdivided)
+{
+	const coordinateType coordinates = coordinatesFor(frame.position.scale / (width / 2.0));
+	const precisionType precision = frame.maxIterations > (1 << 24) ? DoublePrecision : framePrecision;
+	const int digits = (int)ceil(-log10(frame.position.scale)) + 20;
+
+	ostringstream key;
+	key.precision(17);
+	if(layer == juliaLayer)
+		key << "julia " << frame.juliaConstant.real() << " " << frame.juliaConstant.imag();
+	else
+		key << "mandelbrot";
+	key << " at " << frame.position.centerX.toString(digits) << " " << frame.position.centerY.toString(digits)
+		<< " scale " << frame.position.scale << " size " << width << "x" << height
+		<< " iterations " << frame.maxIterations << " in "
+		<< (coordinates == DoubleCoordinates ? precisionTypeArray[precision] : coordinateTypeArray[coordinates]);
+	if(subdivided)
+		key << " subdivided";
+	return key.str();
+}
 
-			colorArray[i] = mixedColor;
+// fills the layers of the frame that aren't complete from layerStore
+void loadLayers()
+{
+	const int layers = layersOf(frame.fractal);
+	loadedLayers = 0;
+	if(layerStore == NULL)
+		return;
+	frameVector<int>& counts = layerCounts;
+	for(int layer = juliaLayer; layer <= mandelbrotLayer; layer *= 2)
+	{
+		if((layers & layer) == 0)
+			continue;
+		bool complete = true;
+		for(size_t pixel = 0; pixel < totalPoints && complete; pixel++)
+			complete = (knownLayers[pixel] & layer) != 0;
+		// subdivided frames make do with exact layers as well
+		if(complete || (!layerStore->load(layerKey(layer, false), &counts[0], totalPoints)
+			&& !(frame.subdivide && layerStore->load(layerKey(layer, true), &counts[0], totalPoints))))
+			continue;
+
+		for(size_t pixel = 0; pixel < totalPoints; pixel++)
+		{
+			orbitCounts loaded = {counts[pixel], counts[pixel]};
+			copyLayers(countArray[pixel], loaded, layer);
+			knownLayers[pixel] |= layer;
 		}
+		loadedLayers |= layer;
 	}
 }
 
-void regenerateColorArray(char command, vec2 location)
+// Keeps the layers the frame iterated for later runs, under a key of their
+// own if the frame was subdivided
+void storeLayers()
 {
-	double iterations;
+	if(layerStore == NULL)
+		return;
+	frameVector<int>& counts = layerCounts;
+	for(int layer = juliaLayer; layer <= mandelbrotLayer; layer *= 2)
+	{
+		if((computedLayers & layer) == 0)
+			continue;
+		for(size_t pixel = 0; pixel < totalPoints; pixel++)
+			counts[pixel] = layer == juliaLayer ? countArray[pixel].julia : countArray[pixel].mandelbrot;
+		layerStore->store(layerKey(layer, frame.subdivide), &counts[0], totalPoints);
+	}
+}
 
-	vec2 center = ((pointArray[0] + pointArray[totalPoints - 1]) / 2.0);
+// hands the tiles the last pass changed to the GLUT thread. Once the pending
+// tiles add up to a frame they are replaced by the whole frame.
+void publishColors()
+{
+	lock_guard<mutex> hold(colorsLock);
+	for(size_t t = 0; t < dirtyTiles.size(); t++)
+	{
+		const tile& area = dirtyTiles[t];
+		for(int y = area.y; y < area.y + area.height; y++)
+			copy(&colorArray[(size_t)y * width + area.x], &colorArray[(size_t)y * width + area.x] + area.width, &finishedColors[(size_t)y * width + area.x]);
+		finishedTiles.push_back(area);
+		finishedArea += (size_t)area.width * area.height;
+	}
+	dirtyTiles.clear();
+	if(finishedArea > totalPoints)
+	{
+		tile whole = {0, 0, width, height};
+		finishedTiles.assign(1, whole);
+		finishedArea = totalPoints;
+	}
+	renderAllocations = allocationCount() - frameStartAllocations;
+	colorsFinished = true;
+}
 
-	for (int i = 0; i < totalPoints; i++)
+void reportFrame()
+{
+	// once double can't tell the pixels apart anymore, frames are deep zooms
+	if(request.coordinates != DoubleCoordinates)
 	{
-		if(command == 'z')
-			pointArray[i] = ((pointArray[i] + center) /2.0) + location * zoomLevel;
-		else if(command == 'Z' && zoomLevel <= 0.5)
-			pointArray[i] = (pointArray[i] - center)* 2.0 + center;
-		if(fractal == 0)
-		{
-			iterations = 0;
+		int digits = (int)ceil(-log10(frame.position.scale)) + 4;
+		cout << "Deep zoom at " << frame.position.centerX.toString(digits) << " " << frame.position.centerY.toString(digits)
+			<< ", scale " << frame.position.scale << " in " << coordinateTypeArray[request.coordinates] << " coordinates" << endl;
+	}
+	if(loadedLayers != 0)
+		cout << "Loaded the " << (loadedLayers == juliaLayer ? "Julia layer" : loadedLayers == mandelbrotLayer ? "Mandelbrot layer" : "Julia and Mandelbrot layers")
+			<< " from " << layerStoreDirectory << endl;
+	cout << "Rendered (lane utilisation " << laneUsage.utilisation() * 100.0 << "%, computed "
+		<< 100.0 * computedPixels / totalPoints << "% of the pixels)." << endl;
+}
 
-			complex<double> constantComplex = juliaConstant;
-			complex<double> complexNum = complex<double>(pointArray[i].x, pointArray[i].y);
+// Computes the pixels of the requested frame that earlier frames and
+// layerStore don't have, publishing the colors after every pass, until a newer
+// frame is requested. The pixels it got to stay known for the next frame, and
+// a finished frame's new layers go to layerStore. False if it didn't finish.
+bool renderFrame(const renderRequest& next)
+{
+	frameStartAllocations = allocationCount();
+	reuseFrames(next);
+	haveFrame = true;
+	loadLayers();
+	laneUsage.reset();
+	computedPixels = 0;
+	computedLayers = 0;
+
+	bool complete = true;
+	for(size_t pixel = 0; pixel < totalPoints && complete; pixel++)
+		complete = knownPixel(pixel);
+
+	// tiles a pass colored before a newer frame came stay in dirtyTiles, so
+	// that frame's first pass publishes them
+	int pass = complete ? 2 : frame.progressive && !frame.subdivide ? 0 : 2;
+	for(; pass < 3; pass++)
+	{
+		renderPass(passStrides[pass], true);
+		if(requestGeneration != frameGeneration)
+			return false;
+		publishColors();
+	}
+	storeLayers();
+	if(frame.report)
+		reportFrame();
+	return true;
+}
 
-			iterations = recursiveColor(complexNum, constantComplex, 0);
+bool sameLayerKey(const storedFrame& stored, const renderRequest& target)
+{
+	return samePosition(stored.position, target.position) && stored.juliaConstant == target.juliaConstant
+		&& stored.maxIterations == target.maxIterations && stored.subdivide == target.subdivide;
+}
 
-			colorArray[i] = translateToColor(iterations);
-		}
-		else if(fractal == 1)
-		{
-			iterations = 0;
+// Renders target in place of the frame, with whatever the frame and the caches
+// have, and keeps what it got to in speculativeFrames, picking up where an
+// interrupted speculation on target stopped. The frame and its statistics are
+// put back afterwards. False if a request came in meanwhile.
+bool renderSpeculation(const renderRequest& target)
+{
+	const renderRequest shown = frame;
+	storedFrame shownFrame;
+	shownFrame.position = frame.position;
+	shownFrame.juliaConstant = frame.juliaConstant;
+	shownFrame.maxIterations = frame.maxIterations;
+	shownFrame.subdivide = frame.subdivide;
+	shownFrame.counts.swap(countArray);
+	shownFrame.known.swap(knownLayers);
+	const unsigned long long shownUsedLanes = laneUsage.usedLanes;
+	const unsigned long long shownTotalLanes = laneUsage.totalLanes;
+	const long long shownPixels = computedPixels;
+	const int shownLayers = computedLayers;
+
+	frame = target;
+	storedFrame buffers;
+	size_t earlier = 0;
+	while(earlier < speculativeFrames.size() && !sameLayerKey(speculativeFrames[earlier], target))
+		++earlier;
+	if(earlier < speculativeFrames.size())
+	{
+		buffers.counts.swap(speculativeFrames[earlier].counts);
+		buffers.known.swap(speculativeFrames[earlier].known);
+		speculativeFrames.erase(speculativeFrames.begin() + earlier);
+	}
+	else
+	{
+		takeFrame(buffers);
+		buffers.known.assign(totalPoints, 0);
+	}
+	countArray.swap(buffers.counts);
+	knownLayers.swap(buffers.known);
+	reuseFrame(shownFrame);
+	reuseCaches();
+	renderPass(1, false);
+
+	speculativeFrames.push_back(storedFrame());
+	storedFrame& speculated = speculativeFrames.back();
+	speculated.position = target.position;
+	speculated.juliaConstant = target.juliaConstant;
+	speculated.maxIterations = target.maxIterations;
+	speculated.subdivide = target.subdivide;
+	speculated.counts.swap(countArray);
+	speculated.known.swap(knownLayers);
+
+	frame = shown;
+	countArray.swap(shownFrame.counts);
+	knownLayers.swap(shownFrame.known);
+	laneUsage.usedLanes = shownUsedLanes;
+	laneUsage.totalLanes = shownTotalLanes;
+	computedPixels = shownPixels;
+	computedLayers = shownLayers;
+	return requestGeneration == frameGeneration;
+}
 
-			complex<double> constantComplex = complex<double>(pointArray[i].x, pointArray[i].y);
-			complex<double> complexNum = complex<double>(0,0);
+// True if speculativeFrames has all of target
+bool speculated(const renderRequest& target)
+{
+	const int layers = layersOf(target.fractal);
+	for(size_t i = 0; i < speculativeFrames.size(); i++)
+	{
+		const storedFrame& stored = speculativeFrames[i];
+		if(!sameLayerKey(stored, target))
+			continue;
+		bool complete = true;
+		for(size_t pixel = 0; pixel < totalPoints && complete; pixel++)
+			complete = (stored.known[pixel] & layers) == layers;
+		if(complete)
+			return true;
+	}
+	return false;
+}
 
-			iterations = recursiveColor(complexNum, constantComplex, 0);
+// the frames speculate() renders, kept so choosing them doesn't allocate
+vector<renderRequest> speculationTargets;
 
-			colorArray[i] = translateToColor(iterations);
-		}
-		else if(fractal == 2)
+// While nothing is requested, renders the frames the next input is likely to
+// ask for: the next and previous Julia constant ('j', 'J') if the fractal type
+// shows a Julia layer, and a click where the mouse rests. Speculative tiles
+// check for requests like any other, so a request waits for at most one tile.
+void speculate(bool hover, vec2 location)
+{
+	speculationTargets.clear();
+	if(layersOf(frame.fractal) & juliaLayer)
+	{
+		int index = 0;
+		while(index < 12 && juliaSetArray[index] != frame.juliaConstant)
+			++index;
+		if(index < 12)
 		{
-			vec3 juliaColor;
-			vec3 mandelbrotColor;
-			vec3 mixedColor;
+			renderRequest next = frame;
+			next.juliaConstant = juliaSetArray[(index + 1) % 12];
+			speculationTargets.push_back(next);
+			next.juliaConstant = juliaSetArray[(index + 11) % 12];
+			speculationTargets.push_back(next);
+		}
+	}
+	if(hover && renderableSpacing(frame.position.scale / 2 / (width / 2.0)))
+	{
+		renderRequest click = frame;
+		click.position = zoomedIn(frame.position, location);
+		speculationTargets.push_back(click);
+	}
 
-			complex<double> constantComplexM = complex<double>(pointArray[i].x, pointArray[i].y);
-			complex<double> complexNumM = complex<double>(0,0);
-			complex<double> complexNumJ = complex<double>(pointArray[i].x, pointArray[i].y);
-			complex<double> constantComplexJ = juliaConstant;
+	// frames no target needs anymore make way for the new ones
+	for(size_t i = speculativeFrames.size(); i-- > 0; )
+	{
+		bool needed = false;
+		for(size_t t = 0; t < speculationTargets.size() && !needed; t++)
+			needed = sameLayerKey(speculativeFrames[i], speculationTargets[t]);
+		if(!needed)
+		{
+			dropFrame(speculativeFrames[i]);
+			speculativeFrames.erase(speculativeFrames.begin() + i);
+		}
+	}
 
-			mandelbrotColor = translateToColor(recursiveColor(complexNumM, constantComplexM, 0));
+	for(size_t t = 0; t < speculationTargets.size(); t++)
+		if(!speculated(speculationTargets[t]) && !renderSpeculation(speculationTargets[t]))
+			return;
+}
 
- 			juliaColor = translateToColor(recursiveColor(complexNumJ, constantComplexJ, 0));
+void renderLoop()
+{
+	colorArray.resize(totalPoints);
+	countArray.resize(totalPoints);
+	layerCounts.resize(totalPoints);
+	{
+		lock_guard<mutex> hold(colorsLock);
+		finishedColors.resize(totalPoints);
+	}
+	knownLayers.assign(totalPoints, 0);
+	// two Julia constants and a click at most
+	speculationTargets.reserve(3);
+	speculativeFrames.reserve(3);
 
-			for(int i = 0; i < 3; i++)
+	for(;;)
+	{
+		renderRequest next;
+		bool speculating = false;
+		bool hover = false;
+		vec2 location;
+		{
+			unique_lock<mutex> hold(requestLock);
+			while(!requestPending && !speculationPending && !stopRendering)
+				requestReady.wait(hold);
+			if(stopRendering)
+				return;
+			if(requestPending)
 			{
-				mixedColor[i] = (juliaColor[i] + mandelbrotColor[i]);
-				while(mixedColor[i] > 1.0)
-					mixedColor[i] -= 1.0;
+				next = pendingRequest;
+				requestPending = false;
+				speculationPending = false;
 			}
-
-			colorArray[i] = mixedColor;
-		}
-		else
-		{
-			vec3 juliaColor;
-			vec3 mandelbrotColor;
-			vec3 mixedColor;
-
-			for(int i = 0; i < totalPoints; i++)
+			else
 			{
-				complex<double> constantComplexM = complex<double>(pointArray[i].x, pointArray[i].y);
-				complex<double> complexNumM = complex<double>(0,0);
-				complex<double> complexNumJ = complex<double>(pointArray[i].x, pointArray[i].y);
-				complex<double> constantComplexJ = juliaConstant;
-
-				mandelbrotColor = translateToColor(recursiveColor(complexNumM, constantComplexM, 0));
-
- 				juliaColor = translateToColor(recursiveColor(complexNumJ, constantComplexJ, 0));
-
-				for(int i = 0; i < 3; i++)
-				{
-					if(juliaColor[i] > mandelbrotColor[i])
-						mixedColor[i] = juliaColor[i];
-					else
-						mixedColor[i] = mandelbrotColor[i];
-				}
-
-				colorArray[i] = mixedColor;
+				speculating = true;
+				speculationPending = false;
+				hover = hovering;
+				location = hoverLocation;
 			}
+			frameGeneration = requestGeneration;
 		}
 
+		if(speculating)
+		{
+			long long start = allocationCount();
+			if(haveFrame)
+				speculate(hover, location);
+			speculationAllocations = allocationCount() - start;
+			if(requestGeneration == frameGeneration)
+				speculationGeneration = frameGeneration;
+		}
+		else if(renderFrame(next))
+		{
+			lock_guard<mutex> hold(requestLock);
+			speculationPending = true;
+		}
 	}
-	if(command == 'Z')
-		if(zoomLevel > 0.5)
-			cerr << "Cannot zoom out anymore" << endl;
-		else
-			zoomLevel *= 2;
-	if(command == 'z')
-		zoomLevel /= 2;
 }
 
-void generateArrays()
+// --- the GLUT thread ---
+
+// Asks the render thread for the current view; a request that replaces one
+// the render thread hasn't started on stays fresh if that one was
+void requestFrame(bool fresh, bool report)
 {
-	cout << "Generating points..." << endl;
-	zoomLevel = 1.0;
-	generatePointArray();
-	generateColorArray();
-	cout << "Generated." << endl;
+	{
+		lock_guard<mutex> hold(requestLock);
+		fresh = fresh || (requestPending && pendingRequest.fresh);
+		pendingRequest.position = view;
+		pendingRequest.fractal = fractal;
+		pendingRequest.colorType = colorType;
+		pendingRequest.juliaConstant = juliaConstant;
+		pendingRequest.maxIterations = maxIterations;
+		pendingRequest.subdivide = subdivide;
+		pendingRequest.progressive = progressive;
+		pendingRequest.fresh = fresh;
+		pendingRequest.report = report;
+		requestPending = true;
+		++requestGeneration;
+	}
+	requestReady.notify_one();
 }
 
-void regenerateArrays(char command, vec2 location)
+void stopRenderer()
 {
-	cout << "Regenerating with command '" << command << "'..." << endl;
-	regenerateColorArray(command, location);
-	//rebuffer colors
-	glBufferSubData(GL_ARRAY_BUFFER,sizeof(vec2) * totalPoints,sizeof(vec3) * totalPoints ,colorArray);
-	cout << "Regenerated." << endl;
+	{
+		lock_guard<mutex> hold(requestLock);
+		stopRendering = true;
+		++requestGeneration;
+	}
+	requestReady.notify_one();
+	renderThread.join();
+	// writes the index if hits reordered it
+	delete layerStore;
+	layerStore = NULL;
 }
 
-vec3 translateToColor(double iterations)
+// where the mouse last moved over the window without a button down, when,
+// and whether the render thread has been told
+vec2 restLocation;
+chrono::steady_clock::time_point restStart;
+bool restPosted = true;
+const chrono::milliseconds restDelay(150);
+
+// once the mouse has rested for restDelay, lets the render thread speculate on
+// a click there
+void postRest()
 {
+	if(restPosted || chrono::steady_clock::now() - restStart < restDelay)
+		return;
+	restPosted = true;
+	{
+		lock_guard<mutex> hold(requestLock);
+		hovering = true;
+		hoverLocation = restLocation;
+		speculationPending = true;
+	}
+	requestReady.notify_one();
+}
 
-	// calculate color
-	// based on hsv scale at http://basecase.org/2011/12/hsv
-	double red = 0;
-	double green = 0;
-	double blue = 0;
-	if(colorType == 0)
+// Colors reach the frame texture through two pixel buffers that stay mapped:
+// while GL copies one into the texture, the next upload fills the other, and
+// a fence per buffer says when GL is done reading it. Without buffer storage
+// (GL 4.4) the tiles are uploaded from finishedColors directly.
+bool persistentUploads = false;
+GLuint uploadBuffers[2];
+pixelRGBA8* mappedUploads[2];
+GLsync uploadFences[2] = {0, 0};
+int uploadBuffer = 0;
+
+void initUploads()
+{
+	persistentUploads = GLEW_ARB_buffer_storage != 0;
+	if(!persistentUploads)
+		return;
+	const GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+	const GLsizeiptr bytes = sizeof(pixelRGBA8) * totalPoints;
+	glGenBuffers(2, uploadBuffers);
+	for(int i = 0; i < 2; i++)
 	{
-		double ratio = 0; // percentage of progress between milestones in HSV wheel
-		double milestone = maxIterations/6;
-		ratio = iterations / milestone;
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadBuffers[i]);
+		glBufferStorage(GL_PIXEL_UNPACK_BUFFER, bytes, NULL, flags);
+		mappedUploads[i] = (pixelRGBA8*)glMapBufferRange(GL_PIXEL_UNPACK_BUFFER, 0, bytes, flags);
+	}
+	glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+}
 
-		if ( iterations < milestone )
-		{
-			red = 1.0;
-			green = ratio;
-			blue = 0.0;
-		}
-		else if ( iterations < (milestone*2) )
-		{
-			red = 1.0 - ratio;
-			green = 1.0;
-			blue = 0.0;
-		}
-		else if ( iterations < (milestone*3) )
+// copies the finished tiles into the frame texture; holds colorsLock
+void uploadTiles()
+{
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+	if(persistentUploads)
+	{
+		// the buffer was last used two uploads ago, so this rarely waits
+		if(uploadFences[uploadBuffer] != 0)
 		{
-			red = 0.0;
-			green = 1.0;
-			blue = ratio;
+			glClientWaitSync(uploadFences[uploadBuffer], GL_SYNC_FLUSH_COMMANDS_BIT, GL_TIMEOUT_IGNORED);
+			glDeleteSync(uploadFences[uploadBuffer]);
 		}
-		else if ( iterations < (milestone*4) )
+		pixelRGBA8* mapped = mappedUploads[uploadBuffer];
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, uploadBuffers[uploadBuffer]);
+		for(size_t t = 0; t < finishedTiles.size(); t++)
 		{
-			red = 0.0;
-			green = 1.0 - ratio;
-			blue = 1.0;
+			const tile& area = finishedTiles[t];
+			size_t first = (size_t)area.y * width + area.x;
+			for(int y = 0; y < area.height; y++)
+				copy(&finishedColors[first + (size_t)y * width], &finishedColors[first + (size_t)y * width] + area.width, mapped + first + (size_t)y * width);
+			glTexSubImage2D(GL_TEXTURE_2D, 0, area.x, area.y, area.width, area.height, GL_RGBA, GL_UNSIGNED_BYTE, BUFFER_OFFSET(first * sizeof(pixelRGBA8)));
 		}
-		else if ( iterations < (milestone*5) )
+		glBindBuffer(GL_PIXEL_UNPACK_BUFFER, 0);
+		uploadFences[uploadBuffer] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+		uploadBuffer ^= 1;
+	}
+	else
+	{
+		for(size_t t = 0; t < finishedTiles.size(); t++)
 		{
-			red = ratio;
-			green = 0;
-			blue = 1.0;
+			const tile& area = finishedTiles[t];
+			glTexSubImage2D(GL_TEXTURE_2D, 0, area.x, area.y, area.width, area.height, GL_RGBA, GL_UNSIGNED_BYTE, &finishedColors[(size_t)area.y * width + area.x]);
 		}
-		else if (iterations < (milestone*6) )
+	}
+	glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	finishedTiles.clear();
+	finishedArea = 0;
+}
+
+// timer callback: shows the colors the render thread finished last
+void showFinishedColors(int value)
+{
+	postRest();
+	{
+		lock_guard<mutex> hold(colorsLock);
+		if(colorsFinished)
 		{
-			red = 1.0;
-			green = 0.0;
-			blue = 1.0 - ratio;
+			uploadTiles();
+			colorsFinished = false;
+			glutPostRedisplay();
 		}
-		else if (iterations == 255)
+	}
+	glutTimerFunc(15, showFinishedColors, value);
+}
+
+void generateArrays()
+{
+	cout << "Generating points..." << endl;
+	view.scale = 1.0;
+	view.centerX = bigFloat(0.0, 3);
+	view.centerY = bigFloat(0.0, 3);
+	zoomHistory.clear();
+	requestFrame(true, true);
+}
+
+// Zooming in moves the center to the clicked pixel and halves the scale, so a
+// quarter of the new pixels are old ones. Zooming out doubles the scale and
+// moves the center onto a pixel of the view zoomed in from, so that frame
+// covers most of the new view and the current frame its center quarter.
+void regenerateArrays(char command, vec2 location)
+{
+	cout << "Regenerating with command '" << command << "'..." << endl;
+	if(command == 'Z')
+		if(view.scale > 0.5)
+			cerr << "Cannot zoom out anymore" << endl;
+		else
+			view.scale *= 2;
+	if(command == 'Z' && !zoomHistory.empty() && zoomHistory.back().scale <= view.scale)
+	{
+		// move the center by at most half a pixel onto a pixel of the view
+		// zoomed in from, so that frame's pixels line up with the new ones
+		const framePosition& previous = zoomHistory.back();
+		if(previous.scale == view.scale)
 		{
-			red = 1.0;
-			green = 0.0;
-			blue = 0.0;
+			const double stepX = view.scale / (width / 2.0);
+			const double stepY = view.scale / (height / 2.0);
+			int words = view.centerX.precision();
+			double pixelX = floor((view.centerX - previous.centerX).toDouble() / stepX + 0.5);
+			double pixelY = floor((view.centerY - previous.centerY).toDouble() / stepY + 0.5);
+			view.centerX = previous.centerX + bigFloat(pixelX * stepX, words);
+			view.centerY = previous.centerY + bigFloat(pixelY * stepY, words);
 		}
+		zoomHistory.pop_back();
 	}
-	else if(colorType == 1)
+	if(command == 'z' && !renderableSpacing(view.scale / 2 / (width / 2.0)))
 	{
-		double LSB = maxIterations / (1<<23);
-		double value;
-
-		union{ 
-			unsigned int uInt; 
-			unsigned char charHolder [4];
-		} doubleAsRGB;
-		
-		value = iterations / LSB;
-		doubleAsRGB.uInt = value;
-
-		red = double(doubleAsRGB.charHolder[2]/255.0);
-		green = double(doubleAsRGB.charHolder[1]/255.0);
-		blue = double(doubleAsRGB.charHolder[0]/255.0);
+		cerr << "Cannot zoom in anymore: pixels would be closer than the smallest normal double" << endl;
+		return;
 	}
-	else
+	if(command == 'z')
 	{
-		double LSB = maxIterations / (1<<25);
-		double value;
-
-		union{ 
-			unsigned int uInt; 
-			unsigned char charHolder [4];
-		} doubleAsRGB;
-		
-		value = iterations / LSB;
-		doubleAsRGB.uInt = value;
-
-		red = double(doubleAsRGB.charHolder[2]/255.0);
-		green = double(doubleAsRGB.charHolder[1]/255.0);
-		blue = double(doubleAsRGB.charHolder[0]/255.0);
-
+		if(zoomHistory.size() == zoomHistoryLength)
+			zoomHistory.erase(zoomHistory.begin());
+		zoomHistory.push_back(view);
 
+		view = zoomedIn(view, location);
 	}
+	requestFrame(false, true);
+}
 
-	return vec3(red, green, blue);
+// Moves the view by whole pixels, right and down the screen for positive
+// counts. The rest of the frame scrolls along, so only the strips that come
+// into view are iterated.
+void panArrays(int right, int down)
+{
+	int words = view.centerX.precision();
+	view.centerX = view.centerX + bigFloat(right * (view.scale / (width / 2.0)), words);
+	view.centerY = view.centerY - bigFloat(down * (view.scale / (height / 2.0)), words);
+	requestFrame(false, false);
 }
 
-void display()
+// the frame texture on a quad over the whole viewport
+void drawFrame()
 {
 	glClear(GL_COLOR_BUFFER_BIT);
-    glDrawArrays(GL_POINTS,0,totalPoints);
+	glDrawArrays(GL_TRIANGLE_STRIP, 0, 4);
+}
+
+void display()
+{
+	drawFrame();
     glFlush();
 	glutSwapBuffers();
 }
 
+// pixel coordinates to [-1,1] across the window, as clicks are zoomed on
+vec2 windowLocation(GLint x, GLint y)
+{
+	double newX = ((double)x/width*2) - 1;
+	double newY = -(((double)y/height*2) - 1);
+	return vec2(newX, newY);
+}
+
+// while the left button is down: where it went down or the last drag event
+// was, and whether it has moved since going down
+bool dragging = false;
+GLint dragX = 0;
+GLint dragY = 0;
+bool dragged = false;
+
 void mouse(GLint button, GLint state, GLint x, GLint y) 
 {
-	//zoom in where you click
-    if (button == GLUT_LEFT_BUTTON && state == GLUT_DOWN) {
-		//convert pixel coords to [-1,1] scale
-		double newX = ((double)x/width*2) - 1;
-		double newY = -(((double)y/height*2) - 1);
-		regenerateArrays('z', vec2(newX,newY));
+	if (button == GLUT_LEFT_BUTTON && state == GLUT_DOWN) {
+		dragging = true;
+		dragX = x;
+		dragY = y;
+		dragged = false;
+	}
+	//zoom in where you click, unless the click was a drag
+    else if (button == GLUT_LEFT_BUTTON && state == GLUT_UP) {
+		dragging = false;
+		if (dragged)
+			return;
+		regenerateArrays('z', windowLocation(x, y));
         glutPostRedisplay();    
     }
 	else if (button == GLUT_RIGHT_BUTTON && state == GLUT_DOWN) {		
@@ -417,6 +1053,48 @@ void mouse(GLint button, GLint state, GLint x, GLint y)
     }
 }
 
+//remember where the mouse rests for speculation
+void passiveMotion(GLint x, GLint y)
+{
+	restLocation = windowLocation(x, y);
+	restStart = chrono::steady_clock::now();
+	restPosted = false;
+}
+
+//drag the view along with the mouse
+void motion(GLint x, GLint y)
+{
+	if (!dragging || (x == dragX && y == dragY))
+		return;
+	panArrays(dragX - x, dragY - y);
+	dragX = x;
+	dragY = y;
+	dragged = true;
+	glutPostRedisplay();
+}
+
+//pan with the arrow keys, an eighth of the view at a time
+void special(int key, int x, int y)
+{
+	switch(key) {
+	case GLUT_KEY_LEFT:
+		panArrays(-width / 8, 0);
+		break;
+	case GLUT_KEY_RIGHT:
+		panArrays(width / 8, 0);
+		break;
+	case GLUT_KEY_UP:
+		panArrays(0, -height / 8);
+		break;
+	case GLUT_KEY_DOWN:
+		panArrays(0, height / 8);
+		break;
+	default:
+		return;
+	}
+	glutPostRedisplay();
+}
+
 void keyboard(unsigned char key, int x, int y)
 {
     switch(key) {
@@ -425,15 +1103,13 @@ void keyboard(unsigned char key, int x, int y)
     case 'Q':
     case 'q':
         cout << "Normal program exit." << endl;
+        stopRenderer();
         exit(EXIT_SUCCESS);
 
 	//reset view
 	case ' ':
 		maxIterations = 100;
-		zoomLevel = 1.0;
 		generateArrays();
-		//rebuffer colors
-		glBufferSubData(GL_ARRAY_BUFFER,sizeof(vec2) * totalPoints,sizeof(vec3) * totalPoints ,colorArray);
 		break;
 	case 's':
 		if(fractal == 0)
@@ -445,8 +1121,7 @@ void keyboard(unsigned char key, int x, int y)
 		else
 			fractal = Julia;
 		cout << "Fractal type changed to " << fractalTypeArray[fractal] << endl;
-		generateArrays();
-		glBufferSubData(GL_ARRAY_BUFFER,sizeof(vec2) * totalPoints,sizeof(vec3) * totalPoints ,colorArray);
+		requestFrame(false, true);
 		break;
 	case 'S':
 		if(fractal == 3)
@@ -458,17 +1133,25 @@ void keyboard(unsigned char key, int x, int y)
 		else
 			fractal = Julia;
 		cout << "Fractal type changed to " << fractalTypeArray[fractal] << endl;
-		generateArrays();
-		glBufferSubData(GL_ARRAY_BUFFER,sizeof(vec2) * totalPoints,sizeof(vec3) * totalPoints ,colorArray);
+		requestFrame(false, true);
 		break;
 	case 'c':
 	case 'C':
+	{
 		cout << "Enter a number of maximum iterations: ";
-		cin >> maxIterations;
+		long entered = 0;
+		if(!(cin >> entered) || entered < 1 || entered > iterationLimit)
+		{
+			cin.clear();
+			cin.ignore(numeric_limits<streamsize>::max(), '\n');
+			cerr << "Maximum iterations must be from 1 to " << iterationLimit << ", keeping " << maxIterations << endl;
+			break;
+		}
+		maxIterations = int(entered);
 		cout << "Maximum number of iterations is now " << maxIterations << endl;
 		generateArrays();
-		glBufferSubData(GL_ARRAY_BUFFER,sizeof(vec2) * totalPoints,sizeof(vec3) * totalPoints ,colorArray);
 		break;
+	}
 	case 'j':
 		switch(juliaNumber)
 		{
@@ -511,8 +1194,7 @@ void keyboard(unsigned char key, int x, int y)
 		}
 		juliaConstant = juliaSetArray[juliaNumber];
 		cout << "Changing Julia constant to " << juliaConstant << endl;
-		generateArrays();
-		glBufferSubData(GL_ARRAY_BUFFER,sizeof(vec2) * totalPoints,sizeof(vec3) * totalPoints ,colorArray);
+		requestFrame(false, true);
 		break;
 	case 'J':
 		switch(juliaNumber)
@@ -556,8 +1238,18 @@ void keyboard(unsigned char key, int x, int y)
 		}
 		juliaConstant = juliaSetArray[juliaNumber];
 		cout << "Changing Julia constant to " << juliaConstant << endl;
+		requestFrame(false, true);
+		break;
+	case 'm':
+	case 'M':
+		subdivide = !subdivide;
+		cout << (subdivide ? "Rendering by Mariani-Silver subdivision" : "Rendering every pixel") << endl;
 		generateArrays();
-		glBufferSubData(GL_ARRAY_BUFFER,sizeof(vec2) * totalPoints,sizeof(vec3) * totalPoints ,colorArray);
+		break;
+	case 'p':
+	case 'P':
+		progressive = !progressive;
+		cout << (progressive ? "Rendering coarse to fine" : "Rendering each frame at once") << endl;
 		break;
 	case 'r':
 		if(colorType == 0)
@@ -567,8 +1259,7 @@ void keyboard(unsigned char key, int x, int y)
 		else
 			colorType = HSV;
 		cout << "Displaying using " << colorSetArray[colorType] << endl;
-		generateArrays();
-		glBufferSubData(GL_ARRAY_BUFFER,sizeof(vec2) * totalPoints,sizeof(vec3) * totalPoints ,colorArray);
+		requestFrame(false, false);
 		break;
 	case 'R':
 		if(colorType == 0)
@@ -578,8 +1269,7 @@ void keyboard(unsigned char key, int x, int y)
 		else
 			colorType = RGB;
 		cout << "Displaying using " << colorSetArray[colorType] << endl;
-		generateArrays();
-		glBufferSubData(GL_ARRAY_BUFFER,sizeof(vec2) * totalPoints,sizeof(vec3) * totalPoints ,colorArray);
+		requestFrame(false, false);
 		break;
     default:
         cerr << "Unknown key command: '" << key << "'" << endl;
@@ -596,38 +1286,130 @@ void init()
     glGenVertexArrays(1,&vertArray);    
     glBindVertexArray(vertArray);     
 
-    // Make a buffer object
-    GLuint buffer;
-    glGenBuffers(1,&buffer);
-    glBindBuffer(GL_ARRAY_BUFFER,buffer);
+    // Make the frame texture, one RGBA8 texel per pixel, black until the
+    // render thread finishes a pass; the quad's corners come from gl_VertexID
+    GLuint texture;
+    glGenTextures(1,&texture);
+    glBindTexture(GL_TEXTURE_2D,texture);
+    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MIN_FILTER,GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_MAG_FILTER,GL_NEAREST);
+    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_S,GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D,GL_TEXTURE_WRAP_T,GL_CLAMP_TO_EDGE);
+    glPixelStorei(GL_UNPACK_ALIGNMENT,4);
+    vector<pixelRGBA8> blank(totalPoints);
+    glTexImage2D(GL_TEXTURE_2D,0,GL_RGBA8,width,height,0,GL_RGBA,GL_UNSIGNED_BYTE,&blank[0]);
 
-    // load the data into the array	
-    glBufferData(GL_ARRAY_BUFFER,sizeof(vec2) * totalPoints + sizeof(vec3) * totalPoints ,NULL,GL_STATIC_DRAW);
-	glBufferSubData(GL_ARRAY_BUFFER,0,sizeof(vec2) * totalPoints,pointArray);
-	glBufferSubData(GL_ARRAY_BUFFER,sizeof(vec2) * totalPoints,sizeof(vec3) * totalPoints ,colorArray);
-	
     // Make a shader program
 	GLuint shaderProgram = initShader("vert.glsl","frag.glsl");
     glUseProgram(shaderProgram);
+	glUniform1i(glGetUniformLocation(shaderProgram,"frameColors"),0);
 
-    // Initialize the vertex shader's vertex position attribute 
-	GLuint vPosition = glGetAttribLocation(shaderProgram,"vPosition");
-    glEnableVertexAttribArray(vPosition);
-    glVertexAttribPointer(vPosition,2,GL_DOUBLE,GL_FALSE,0,0);
-    
-    // Initialize the vertex shader's vertex color attribute 
-	GLuint vColor = glGetAttribLocation(shaderProgram,"vColor");
-    glEnableVertexAttribArray(vColor);
-	glVertexAttribPointer(vColor,3,GL_DOUBLE,GL_FALSE,0,BUFFER_OFFSET(sizeof(vec2)*totalPoints));
+	initUploads();
 
 	glDisable(GL_DEPTH_TEST);
 }
 
+// the frame -selftest expects and the one it reads back, kept so that checking
+// a frame allocates nothing while it renders
+frameVector<pixelRGBA8> expectedColors;
+frameVector<pixelRGBA8> shownColors;
+
+// Waits for the frame asked for last, uploads it as showFinishedColors does,
+// draws it into the bound framebuffer and reads it back; returns how many
+// pixels show a different color than the render thread gave them, and in
+// allocations how many allocations rendering it and speculating after it made
+size_t shownDifferences(long long& allocations)
+{
+	bool finished = false;
+	while(!finished)
+	{
+		this_thread::sleep_for(chrono::milliseconds(15));
+		lock_guard<mutex> hold(colorsLock);
+		if(colorsFinished)
+		{
+			uploadTiles();
+			expectedColors = finishedColors;
+			allocations = renderAllocations;
+			colorsFinished = false;
+			finished = true;
+		}
+	}
+	// and the speculation that follows it
+	while(speculationGeneration != requestGeneration)
+		this_thread::sleep_for(chrono::milliseconds(1));
+	allocations += speculationAllocations;
+
+	drawFrame();
+	glPixelStorei(GL_PACK_ALIGNMENT, 4);
+	glReadPixels(0, 0, width, height, GL_RGBA, GL_UNSIGNED_BYTE, &shownColors[0]);
+
+	// GL's rows run up the screen, the frame's down it
+	size_t wrong = 0;
+	for(int y = 0; y < height; y++)
+		for(int x = 0; x < width; x++)
+			if(!sameColor(shownColors[(size_t)(height - 1 - y) * width + x], expectedColors[(size_t)y * width + x]))
+				++wrong;
+	return wrong;
+}
+
+// Renders the first view at once and then small pans, which only upload the
+// tiles they changed, each into an offscreen RGBA8 target; true if every pixel
+// shows the color the render thread gave it every time, and the pans made
+// once the frame cache is full allocate nothing. Only needs a GL context, so
+// it also runs on Mesa's software renderer.
+bool displayMatchesFrame()
+{
+	GLuint target, framebuffer;
+	glGenRenderbuffers(1, &target);
+	glBindRenderbuffer(GL_RENDERBUFFER, target);
+	glRenderbufferStorage(GL_RENDERBUFFER, GL_RGBA8, width, height);
+	glGenFramebuffers(1, &framebuffer);
+	glBindFramebuffer(GL_FRAMEBUFFER, framebuffer);
+	glFramebufferRenderbuffer(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_RENDERBUFFER, target);
+	glViewport(0, 0, width, height);
+	expectedColors.resize(totalPoints);
+	shownColors.resize(totalPoints);
+
+	progressive = false;
+	generateArrays();
+	long long allocations = 0;
+	size_t wrong = shownDifferences(allocations);
+
+	// every pan stores a frame in the cache; until it is full that takes new
+	// buffers, after that the dropped frame's
+	const int warmPans = (int)frameCacheLength + 1;
+	long long steadyAllocations = 0;
+	for(int pan = 0; pan < warmPans + 4; pan++)
+	{
+		panArrays(3, 2);
+		wrong += shownDifferences(allocations);
+		if(pan >= warmPans)
+			steadyAllocations += allocations;
+	}
+
+	glBindFramebuffer(GL_FRAMEBUFFER, 0);
+	glDeleteFramebuffers(1, &framebuffer);
+	glDeleteRenderbuffers(1, &target);
+	cout << "Display self-test (" << (persistentUploads ? "persistent pixel buffers" : "direct uploads") << "): " << wrong
+		<< " pixels differ over " << warmPans + 5 << " frames, the last 4 made " << steadyAllocations << " allocations" << endl;
+#ifndef FRACTAL_COUNT_ALLOCATIONS
+	cout << "Only frame buffer allocations were counted; build with FRACTAL_COUNT_ALLOCATIONS defined to count every one" << endl;
+#endif
+	return wrong == 0 && steadyAllocations == 0;
+}
+
 
 
 int main(int argc, char** argv) 
 {
-	generateArrays();
+	// juliaSetArray lives in FractalCore.cpp, so don't rely on static initialization order
+	juliaConstant = juliaSetArray[juliaNumber];
+	// the self-test compares fresh renders and mustn't fill the cache with them
+	const bool selfTest = argc > 1 && string(argv[1]) == "-selftest";
+	scheduler = new tileScheduler();
+	layerStore = selfTest ? NULL : new diskCache(layerStoreDirectory, layerStoreBudget);
+	cout << "Rendering on " << scheduler->threadCount() << " threads with the " << instructionSetArray[frameIsa] << " kernel" << endl;
+	renderThread = thread(renderLoop);
 
 	glutInit(&argc,argv);
     glutInitDisplayMode(GLUT_DOUBLE|GLUT_RGB|GLUT_DEPTH);
@@ -638,10 +1420,21 @@ int main(int argc, char** argv)
 
 	glutDisplayFunc(display);
     glutMouseFunc(mouse);
+    glutMotionFunc(motion);
+    glutPassiveMotionFunc(passiveMotion);
     glutKeyboardFunc(keyboard);
+    glutSpecialFunc(special);
 
 	glewInit();
 	init();
+	if(selfTest)
+	{
+		bool matches = displayMatchesFrame();
+		stopRenderer();
+		return matches ? EXIT_SUCCESS : EXIT_FAILURE;
+	}
+	generateArrays();
+	glutTimerFunc(15, showFinishedColors, 0);
 
     glutMainLoop();
 
@@ -0,0 +1,63 @@
+#include "FrameBuffers.h"
+
+#include <atomic>
+#include <cstdlib>
+
+#if defined(_WIN32)
+#  include <malloc.h>
+#else
+#  include <sys/mman.h>
+#endif
+
+using namespace std;
+
+static const size_t hugePageSize = (size_t)2 << 20;
+static const size_t cacheLineSize = 64;
+
+static atomic<long long> allocations(0);
+
+// what a buffer of bytes takes up: whole huge pages if it fills one
+static size_t frameBytes(size_t bytes)
+{
+	return bytes >= hugePageSize ? (bytes + hugePageSize - 1) / hugePageSize * hugePageSize : bytes;
+}
+
+void* allocateFrameMemory(size_t bytes)
+{
+	++allocations;
+	// rounding up to whole huge pages would wrap around
+	if(bytes > size_t(-1) - hugePageSize)
+		throw bad_alloc();
+	const size_t size = frameBytes(bytes);
+	const size_t alignment = size >= hugePageSize ? hugePageSize : cacheLineSize;
+	void* memory = NULL;
+#if defined(_WIN32)
+	// large pages on Windows need a privilege most users don't have, so this
+	// only gets the alignment
+	memory = _aligned_malloc(size > 0 ? size : 1, alignment);
+#else
+	if(posix_memalign(&memory, alignment, size > 0 ? size : 1) != 0)
+		memory = NULL;
+#  if defined(MADV_HUGEPAGE)
+	if(memory != NULL && alignment == hugePageSize)
+		madvise(memory, size, MADV_HUGEPAGE);
+#  endif
+#endif
+	if(memory == NULL)
+		throw bad_alloc();
+	return memory;
+}
+
+void freeFrameMemory(void* memory, size_t /*bytes*/)
+{
+#if defined(_WIN32)
+	_aligned_free(memory);
+#else
+	free(memory);
+#endif
+}
+
+long long frameAllocations()
+{
+	return allocations;
+}
@@ -0,0 +1,48 @@
+// FrameBuffers.h
+// Memory for arrays the size of a frame. Buffers of at least a huge page
+// (2 MB) are aligned to one and rounded up to whole ones, so the OS can back
+// them with huge pages and a pass over a frame doesn't miss the TLB every
+// 4 KB; smaller buffers are aligned to a cache line. frameVector is a
+// std::vector in that memory. Renderers allocate their frame buffers once
+// and reuse them, so allocations here should only happen when the frame
+// size changes; frameAllocations() counts them to check that.
+
+#pragma once
+
+#include <cstddef>
+#include <new>
+#include <vector>
+
+// Throws std::bad_alloc if the memory can't be had
+void* allocateFrameMemory(size_t bytes);
+void freeFrameMemory(void* memory, size_t bytes);
+
+// How many times allocateFrameMemory() has been called
+long long frameAllocations();
+
+template<typename T>
+struct frameAllocator
+{
+	typedef T value_type;
+
+	frameAllocator() {}
+	template<typename U>
+	frameAllocator(const frameAllocator<U>&) {}
+
+	T* allocate(size_t count)
+	{
+		// count * sizeof(T) would wrap around to a small buffer
+		if(count > size_t(-1) / sizeof(T))
+			throw std::bad_alloc();
+		return (T*)allocateFrameMemory(count * sizeof(T));
+	}
+	void deallocate(T* memory, size_t count) { freeFrameMemory(memory, count * sizeof(T)); }
+};
+
+template<typename T, typename U>
+bool operator==(const frameAllocator<T>&, const frameAllocator<U>&) { return true; }
+template<typename T, typename U>
+bool operator!=(const frameAllocator<T>&, const frameAllocator<U>&) { return false; }
+
+template<typename T>
+using frameVector = std::vector<T, frameAllocator<T> >;
@@ -0,0 +1,222 @@
+#include "ImageWriter.h"
+
+#include <algorithm>
+#include <cctype>
+
+using namespace std;
+
+// The CRC-32 of each byte value, built on first use. A function-local static
+// is initialized once even when several threads write images at the same time.
+struct crcTable
+{
+	unsigned int entries[256];
+
+	crcTable()
+	{
+		for(unsigned int n = 0; n < 256; n++)
+		{
+			unsigned int c = n;
+			for(int k = 0; k < 8; k++)
+				c = (c & 1) ? 0xedb88320u ^ (c >> 1) : c >> 1;
+			entries[n] = c;
+		}
+	}
+};
+
+static unsigned int updateCRC(unsigned int crc, const unsigned char* data, size_t length)
+{
+	static const crcTable table;
+	for(size_t i = 0; i < length; i++)
+		crc = table.entries[(crc ^ data[i]) & 0xff] ^ (crc >> 8);
+	return crc;
+}
+
+static void appendBigEndian(vector<unsigned char>& out, unsigned int value)
+{
+	out.push_back((unsigned char)(value >> 24));
+	out.push_back((unsigned char)(value >> 16));
+	out.push_back((unsigned char)(value >> 8));
+	out.push_back((unsigned char)(value));
+}
+
+static bool writeChunk(FILE* fp, const char* type, const unsigned char* data, size_t length)
+{
+	vector<unsigned char> header;
+	appendBigEndian(header, (unsigned int)length);
+	header.insert(header.end(), type, type + 4);
+
+	unsigned int crc = updateCRC(0xffffffffu, header.data() + 4, 4);
+	if(length > 0)
+		crc = updateCRC(crc, data, length);
+
+	vector<unsigned char> footer;
+	appendBigEndian(footer, crc ^ 0xffffffffu);
+
+	return fwrite(header.data(), 1, header.size(), fp) == header.size()
+		&& (length == 0 || fwrite(data, 1, length, fp) == length)
+		&& fwrite(footer.data(), 1, footer.size(), fp) == footer.size();
+}
+
+static bool writeChunk(FILE* fp, const char* type, const vector<unsigned char>& data)
+{
+	return writeChunk(fp, type, data.data(), data.size());
+}
+
+// Each IDAT chunk holds at most this much, well below PNG's 2^31 limit
+static const size_t maxChunk = (size_t)1 << 30;
+
+imageStream::imageStream() : fp(NULL), png(false), failed(false), rowBytes(0), rowsLeft(0), rawLeft(0), zlibStarted(false), blockLeft(0), adlerA(1), adlerB(0)
+{
+}
+
+imageStream::~imageStream()
+{
+	if(fp != NULL)
+		fclose(fp);
+}
+
+bool imageStream::open(const string& filename, int width, int height)
+{
+	size_t dot = filename.find_last_of('.');
+	string extension = (dot == string::npos) ? "" : filename.substr(dot);
+	for(size_t i = 0; i < extension.size(); i++)
+		extension[i] = (char)tolower(extension[i]);
+
+	if(extension == ".png")
+		return openPNG(filename, width, height);
+	return openPPM(filename, width, height);
+}
+
+bool imageStream::openPPM(const string& filename, int width, int height)
+{
+	close();
+	fp = fopen(filename.c_str(), "wb");
+	if(fp == NULL)
+		return false;
+
+	png = false;
+	failed = fprintf(fp, "P6\n%d %d\n255\n", width, height) < 0;
+	rowBytes = uint64_t(width) * 3;
+	rowsLeft = height;
+	return !failed;
+}
+
+// The image data goes out as a zlib stream of uncompressed ("stored") deflate
+// blocks, which keeps the writer dependency free and fast at the cost of size
+bool imageStream::openPNG(const string& filename, int width, int height)
+{
+	close();
+	fp = fopen(filename.c_str(), "wb");
+	if(fp == NULL)
+		return false;
+
+	static const unsigned char signature[8] = {137, 'P', 'N', 'G', '\r', '\n', 26, '\n'};
+	bool written = fwrite(signature, 1, 8, fp) == 8;
+
+	vector<unsigned char> ihdr;
+	appendBigEndian(ihdr, width);
+	appendBigEndian(ihdr, height);
+	ihdr.push_back(8);	// bit depth
+	ihdr.push_back(2);	// truecolor
+	ihdr.push_back(0);	// deflate
+	ihdr.push_back(0);	// adaptive filtering
+	ihdr.push_back(0);	// no interlace
+	written = written && writeChunk(fp, "IHDR", ihdr);
+
+	png = true;
+	failed = !written;
+	rowBytes = uint64_t(width) * 3;
+	rowsLeft = height;
+	rawLeft = (rowBytes + 1) * height;
+	zlibStarted = false;
+	blockLeft = 0;
+	adlerA = 1;
+	adlerB = 0;
+	return written;
+}
+
+bool imageStream::write(const unsigned char* pixels, int rows)
+{
+	if(fp == NULL || failed || rows < 0 || rows > rowsLeft)
+		return false;
+	if(rows == 0)
+		return true;
+
+	if(!png)
+	{
+		// the rows are in memory, so they fit in a size_t
+		size_t bytes = size_t(rowBytes * rows);
+		failed = fwrite(pixels, 1, bytes, fp) != bytes;
+		rowsLeft -= rows;
+		return !failed;
+	}
+
+	const unsigned int maxBlock = 65535;
+	const size_t rowSize = size_t(rowBytes);
+	size_t rawBytes = (rowSize + 1) * rows;
+
+	idat.clear();
+	idat.reserve(rawBytes + (rawBytes / maxBlock + 2) * 5 + 6);
+	if(!zlibStarted)
+	{
+		// the zlib header opens the first chunk
+		idat.push_back(0x78);
+		idat.push_back(0x01);
+		zlibStarted = true;
+	}
+
+	for(int y = 0; y < rows; y++)
+	{
+		const unsigned char* row = pixels + rowSize * y;
+		for(size_t i = 0; i <= rowSize; i++)
+		{
+			if(blockLeft == 0)
+			{
+				blockLeft = rawLeft < maxBlock ? (unsigned int)rawLeft : maxBlock;
+				idat.push_back(rawLeft == blockLeft ? 1 : 0);
+				idat.push_back((unsigned char)(blockLeft));
+				idat.push_back((unsigned char)(blockLeft >> 8));
+				idat.push_back((unsigned char)(~blockLeft));
+				idat.push_back((unsigned char)(~blockLeft >> 8));
+			}
+
+			// every scanline starts with filter type 0 (none)
+			unsigned char value = (i == 0) ? 0 : row[i - 1];
+			idat.push_back(value);
+			adlerA = (adlerA + value) % 65521;
+			adlerB = (adlerB + adlerA) % 65521;
+			--blockLeft;
+			--rawLeft;
+		}
+	}
+	rowsLeft -= rows;
+	if(rowsLeft == 0)
+		appendBigEndian(idat, (adlerB << 16) | adlerA);
+
+	for(size_t start = 0; start < idat.size() && !failed; start += maxChunk)
+	{
+		size_t length = min(idat.size() - start, maxChunk);
+		failed = !writeChunk(fp, "IDAT", &idat[start], length);
+	}
+	return !failed;
+}
+
+bool imageStream::close()
+{
+	if(fp == NULL)
+		return false;
+
+	bool written = !failed && rowsLeft == 0;
+	if(png)
+		written = written && writeChunk(fp, "IEND", NULL, 0);
+	written = (fclose(fp) == 0) && written;
+	fp = NULL;
+	idat = vector<unsigned char>();
+	return written;
+}
+
+bool writeImage(const string& filename, const unsigned char* pixels, int width, int height)
+{
+	imageStream stream;
+	return stream.open(filename, width, height) && stream.write(pixels, height) && stream.close();
+}
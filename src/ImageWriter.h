@@ -0,0 +1,55 @@
+// ImageWriter.h
+// Writes 8-bit RGB images to disk without any external libraries.
+
+#pragma once
+
+#include <cstdio>
+#include <stdint.h>
+#include <string>
+#include <vector>
+
+// Writes a whole image through an imageStream. Pixels are packed RGB, top row
+// first, 3 bytes per pixel. Picks PNG for a ".png" extension and PPM for
+// anything else.
+bool writeImage(const std::string& filename, const unsigned char* pixels, int width, int height);
+
+// Writes an image a few rows at a time, so images larger than memory can go
+// to disk as they are rendered. The file is complete once all height rows
+// have been written and close() succeeds.
+class imageStream
+{
+public:
+	imageStream();
+	~imageStream();
+
+	// Picks the format from the extension like writeImage()
+	bool open(const std::string& filename, int width, int height);
+	bool openPPM(const std::string& filename, int width, int height);
+	bool openPNG(const std::string& filename, int width, int height);
+
+	// The next rows of the image, packed like writeImage() wants them
+	bool write(const unsigned char* pixels, int rows);
+
+	// False if anything failed to write or rows are missing
+	bool close();
+
+private:
+	FILE* fp;
+	bool png;
+	bool failed;
+	// 64 bits, as images written a band at a time can have more than size_t
+	// counts in 32 bit builds
+	uint64_t rowBytes;
+	int rowsLeft;
+
+	// the zlib stream of stored blocks that runs through the IDAT chunks
+	uint64_t rawLeft;
+	bool zlibStarted;
+	unsigned int blockLeft;
+	unsigned int adlerA;
+	unsigned int adlerB;
+	std::vector<unsigned char> idat;
+
+	imageStream(const imageStream&);
+	imageStream& operator=(const imageStream&);
+};
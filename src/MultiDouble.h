@@ -0,0 +1,324 @@
+// MultiDouble.h
+// Double-double and quad-double numbers: unevaluated sums of 2 or 4 doubles
+// with about 106 and 212 significant bits, built from the error-free sum and
+// product of two doubles (Hida, Li and Bailey's QD algorithms). They are much
+// cheaper than bigFloat and iterate views from about 1e-15 to 1e-30 and 1e-60
+// directly.
+//
+// Additions are the "sloppy" kind, whose error is relative to the operands
+// rather than to the result. Orbits stay within |z| <= 2, so that error is a
+// fixed absolute amount, which is all the escape-time loops need.
+//
+// The error-free transformations rely on every operation being rounded to
+// double; don't build this with x87 math or -ffast-math style options, and
+// include FloatContraction.h first so no multiply and add fuse into an FMA.
+//
+// Like FractalPolicies.h this is included by every kernel translation unit
+// after its instruction set is enabled, so it all lives in an unnamed namespace.
+
+#pragma once
+
+namespace {
+
+namespace multiDouble {
+
+// s + error == a + b exactly
+inline double twoSum(double a, double b, double& error)
+{
+	double s = a + b;
+	double bVirtual = s - a;
+	error = (a - (s - bVirtual)) + (b - bVirtual);
+	return s;
+}
+
+// Same as twoSum when |a| >= |b|
+inline double quickTwoSum(double a, double b, double& error)
+{
+	double s = a + b;
+	error = b - (s - a);
+	return s;
+}
+
+// p + error == a * b exactly
+inline double twoProduct(double a, double b, double& error)
+{
+	double p = a * b;
+
+	// Dekker's split into 26 bit halves, whose products are exact; no fma, as
+	// that would need the standard library or an instruction set of its own
+	const double splitter = 134217729.0;	// 2^27 + 1
+	double t = splitter * a;
+	double aHigh = t - (t - a);
+	double aLow = a - aHigh;
+	t = splitter * b;
+	double bHigh = t - (t - b);
+	double bLow = b - bHigh;
+	error = ((aHigh * bHigh - p) + aHigh * bLow + aLow * bHigh) + aLow * bLow;
+	return p;
+}
+
+// a + b + c as a and b, the rest added to c
+inline void threeSum(double& a, double& b, double& c)
+{
+	double t2, t3;
+	double t1 = twoSum(a, b, t2);
+	a = twoSum(c, t1, t3);
+	b = twoSum(t2, t3, c);
+}
+
+// a + b + c as a and b, dropping what is left
+inline void threeSumShort(double& a, double& b, double c)
+{
+	double t2, t3;
+	double t1 = twoSum(a, b, t2);
+	a = twoSum(c, t1, t3);
+	b = t2 + t3;
+}
+
+// Turns five overlapping terms into four non-overlapping ones
+inline void renormalize(double& c0, double& c1, double& c2, double& c3, double c4)
+{
+	double s0, s1, s2 = 0.0, s3 = 0.0;
+
+	s0 = quickTwoSum(c3, c4, c4);
+	s0 = quickTwoSum(c2, s0, c3);
+	s0 = quickTwoSum(c1, s0, c2);
+	c0 = quickTwoSum(c0, s0, c1);
+
+	s0 = c0;
+	s1 = c1;
+	if(s1 != 0.0)
+	{
+		s1 = quickTwoSum(s1, c2, s2);
+		if(s2 != 0.0)
+		{
+			s2 = quickTwoSum(s2, c3, s3);
+			if(s3 != 0.0)
+				s3 += c4;
+			else
+				s2 = quickTwoSum(s2, c4, s3);
+		}
+		else
+		{
+			s1 = quickTwoSum(s1, c3, s2);
+			if(s2 != 0.0)
+				s2 = quickTwoSum(s2, c4, s3);
+			else
+				s1 = quickTwoSum(s1, c4, s2);
+		}
+	}
+	else
+	{
+		s0 = quickTwoSum(s0, c2, s1);
+		if(s1 != 0.0)
+		{
+			s1 = quickTwoSum(s1, c3, s2);
+			if(s2 != 0.0)
+				s2 = quickTwoSum(s2, c4, s3);
+			else
+				s1 = quickTwoSum(s1, c4, s2);
+		}
+		else
+		{
+			s0 = quickTwoSum(s0, c3, s1);
+			if(s1 != 0.0)
+				s1 = quickTwoSum(s1, c4, s2);
+			else
+				s0 = quickTwoSum(s0, c4, s1);
+		}
+	}
+
+	c0 = s0;
+	c1 = s1;
+	c2 = s2;
+	c3 = s3;
+}
+
+}
+
+struct doubleDouble
+{
+	double high;
+	double low;
+
+	doubleDouble() : high(0.0), low(0.0) {}
+	explicit doubleDouble(double value) : high(value), low(0.0) {}
+	doubleDouble(double high, double low) : high(high), low(low) {}
+
+	// for iteration counts, which are whole numbers in high
+	explicit operator int() const { return int(high); }
+};
+
+inline doubleDouble operator+(const doubleDouble& a, const doubleDouble& b)
+{
+	double error;
+	double s = multiDouble::twoSum(a.high, b.high, error);
+	error += a.low + b.low;
+	s = multiDouble::quickTwoSum(s, error, error);
+	return doubleDouble(s, error);
+}
+
+inline doubleDouble operator+(const doubleDouble& a, double b)
+{
+	double error;
+	double s = multiDouble::twoSum(a.high, b, error);
+	error += a.low;
+	s = multiDouble::quickTwoSum(s, error, error);
+	return doubleDouble(s, error);
+}
+
+inline doubleDouble operator-(const doubleDouble& a, const doubleDouble& b)
+{
+	return a + doubleDouble(-b.high, -b.low);
+}
+
+inline doubleDouble operator*(const doubleDouble& a, const doubleDouble& b)
+{
+	double error;
+	double p = multiDouble::twoProduct(a.high, b.high, error);
+	error += a.high * b.low + a.low * b.high;
+	p = multiDouble::quickTwoSum(p, error, error);
+	return doubleDouble(p, error);
+}
+
+inline bool operator==(const doubleDouble& a, const doubleDouble& b)
+{
+	return a.high == b.high && a.low == b.low;
+}
+
+inline bool operator<(const doubleDouble& a, const doubleDouble& b)
+{
+	return a.high < b.high || (a.high == b.high && a.low < b.low);
+}
+
+inline bool operator<=(const doubleDouble& a, const doubleDouble& b)
+{
+	return a.high < b.high || (a.high == b.high && a.low <= b.low);
+}
+
+struct quadDouble
+{
+	double part[4];
+
+	quadDouble() { part[0] = part[1] = part[2] = part[3] = 0.0; }
+	explicit quadDouble(double value) { part[0] = value; part[1] = part[2] = part[3] = 0.0; }
+};
+
+inline quadDouble operator+(const quadDouble& a, const quadDouble& b)
+{
+	double t0, t1, t2, t3;
+	quadDouble sum;
+	double* s = sum.part;
+
+	s[0] = multiDouble::twoSum(a.part[0], b.part[0], t0);
+	s[1] = multiDouble::twoSum(a.part[1], b.part[1], t1);
+	s[2] = multiDouble::twoSum(a.part[2], b.part[2], t2);
+	s[3] = multiDouble::twoSum(a.part[3], b.part[3], t3);
+
+	s[1] = multiDouble::twoSum(s[1], t0, t0);
+	multiDouble::threeSum(s[2], t0, t1);
+	multiDouble::threeSumShort(s[3], t0, t2);
+	t0 = t0 + t1 + t3;
+
+	multiDouble::renormalize(s[0], s[1], s[2], s[3], t0);
+	return sum;
+}
+
+inline quadDouble operator+(const quadDouble& a, double b)
+{
+	double e;
+	quadDouble sum;
+	double* s = sum.part;
+
+	s[0] = multiDouble::twoSum(a.part[0], b, e);
+	s[1] = multiDouble::twoSum(a.part[1], e, e);
+	s[2] = multiDouble::twoSum(a.part[2], e, e);
+	s[3] = multiDouble::twoSum(a.part[3], e, e);
+
+	multiDouble::renormalize(s[0], s[1], s[2], s[3], e);
+	return sum;
+}
+
+inline quadDouble operator-(const quadDouble& a, const quadDouble& b)
+{
+	quadDouble negated;
+	for(int i = 0; i < 4; i++)
+		negated.part[i] = -b.part[i];
+	return a + negated;
+}
+
+inline quadDouble operator*(const quadDouble& a, const quadDouble& b)
+{
+	const double* x = a.part;
+	const double* y = b.part;
+	double q0, q1, q2, q3, q4, q5;
+	double t0, t1;
+
+	// terms of order 1, eps, eps^2 exactly, eps^3 approximately
+	double p0 = multiDouble::twoProduct(x[0], y[0], q0);
+
+	double p1 = multiDouble::twoProduct(x[0], y[1], q1);
+	double p2 = multiDouble::twoProduct(x[1], y[0], q2);
+
+	double p3 = multiDouble::twoProduct(x[0], y[2], q3);
+	double p4 = multiDouble::twoProduct(x[1], y[1], q4);
+	double p5 = multiDouble::twoProduct(x[2], y[0], q5);
+
+	multiDouble::threeSum(p1, p2, q0);
+
+	multiDouble::threeSum(p2, q1, q2);
+	multiDouble::threeSum(p3, p4, p5);
+
+	double s0 = multiDouble::twoSum(p2, p3, t0);
+	double s1 = multiDouble::twoSum(q1, p4, t1);
+	double s2 = q2 + p5;
+	s1 = multiDouble::twoSum(s1, t0, t0);
+	s2 += (t0 + t1);
+
+	s1 += x[0] * y[3] + x[1] * y[2] + x[2] * y[1] + x[3] * y[0] + q0 + q3 + q4 + q5;
+
+	quadDouble product;
+	product.part[0] = p0;
+	product.part[1] = p1;
+	product.part[2] = s0;
+	product.part[3] = s1;
+	multiDouble::renormalize(product.part[0], product.part[1], product.part[2], product.part[3], s2);
+	return product;
+}
+
+inline bool operator==(const quadDouble& a, const quadDouble& b)
+{
+	return a.part[0] == b.part[0] && a.part[1] == b.part[1] && a.part[2] == b.part[2] && a.part[3] == b.part[3];
+}
+
+inline bool operator<(const quadDouble& a, const quadDouble& b)
+{
+	for(int i = 0; i < 3; i++)
+		if(a.part[i] != b.part[i])
+			return a.part[i] < b.part[i];
+	return a.part[3] < b.part[3];
+}
+
+inline bool operator<=(const quadDouble& a, const quadDouble& b)
+{
+	for(int i = 0; i < 3; i++)
+		if(a.part[i] != b.part[i])
+			return a.part[i] < b.part[i];
+	return a.part[3] <= b.part[3];
+}
+
+// Kernel inputs (PointRenderer.h): the offset value added to the view center
+inline void planeCoordinate(doubleDouble& coordinate, double value, const double* center)
+{
+	coordinate = doubleDouble(center[0], center[1]) + value;
+}
+
+inline void planeCoordinate(quadDouble& coordinate, double value, const double* center)
+{
+	quadDouble point;
+	for(int i = 0; i < 4; i++)
+		point.part[i] = center[i];
+	coordinate = point + value;
+}
+
+}
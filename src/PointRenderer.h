@@ -0,0 +1,70 @@
+// PointRenderer.h
+// Builds the pointRenderer instantiations for one instruction set. A kernel
+// translation unit defines its loop policies (SimdKernel.h, or scalarLoop in
+// EscapeKernel.cpp), includes MultiDouble.h, FractalPolicies.h and this
+// header, and passes its loops to fillPointRenderers().
+
+#pragma once
+
+namespace {
+
+// Kernel inputs: float and double kernels are given plane coordinates, the
+// multi-double ones offsets from the view center (MultiDouble.h)
+inline void planeCoordinate(float& coordinate, double value, const double* /*center*/)
+{
+	coordinate = float(value);
+}
+
+inline void planeCoordinate(double& coordinate, double value, const double* /*center*/)
+{
+	coordinate = value;
+}
+
+template<class loop, class fractal>
+void renderPoints(const orbitConstants& constants, const pixelGrid& grid, const int* pixels, int count, orbitCounts* counts, laneStatistics* statistics)
+{
+	typedef typename loop::real real;
+
+	const int chunk = 1024;
+	real chunkRe[chunk];
+	real chunkIm[chunk];
+	int firstIterations[chunk];
+	int secondIterations[chunk];
+	const double* centerRe = constants.center != NULL ? constants.center->re : NULL;
+	const double* centerIm = constants.center != NULL ? constants.center->im : NULL;
+
+	for(int first = 0; first < count; first += chunk)
+	{
+		int points = count - first < chunk ? count - first : chunk;
+		for(int i = 0; i < points; i++)
+		{
+			int x = pixels[first + i] % grid.width;
+			int y = pixels[first + i] / grid.width;
+			planeCoordinate(chunkRe[i], grid.originRe + (x - grid.originX) * grid.stepRe, centerRe);
+			planeCoordinate(chunkIm[i], grid.originIm - (y - grid.originY) * grid.stepIm, centerIm);
+		}
+
+		fractal::template iterate<loop>(chunkRe, chunkIm, points, constants, firstIterations, secondIterations, counts + first, statistics);
+	}
+}
+
+template<class loop>
+void fillFractals(pointRenderer* renderers)
+{
+	renderers[Julia] = renderPoints<loop, singleFractal<juliaFormula> >;
+	renderers[Mandelbrot] = renderPoints<loop, singleFractal<mandelbrotFormula> >;
+	renderers[Mixed] = renderPoints<loop, blendedFractal<addedBlend> >;
+	renderers[Greater] = renderPoints<loop, blendedFractal<greaterBlend> >;
+}
+
+// Fills one kernelMode row of a pointRendererTable but for quad-double,
+// which EscapeKernel.cpp adds to every table
+template<class floatLoop, class doubleLoop, class doubleDoubleLoop>
+void fillPointRenderers(pointRenderer (*renderers)[4])
+{
+	fillFractals<floatLoop>(renderers[FloatPrecision]);
+	fillFractals<doubleLoop>(renderers[DoublePrecision]);
+	fillFractals<doubleDoubleLoop>(renderers[DoubleDoublePrecision]);
+}
+
+}
@@ -0,0 +1,531 @@
+// SimdKernel.h
+// Escape-time loops shared by the SSE2, AVX2 and AVX-512 kernels. Each of those
+// translation units defines small traits structs wrapping its intrinsics and
+// includes this header after enabling its instruction set, so the loops below
+// are compiled once per instruction set and precision.
+//
+// Everything lives in an unnamed namespace so the per-ISA instantiations can
+// never be merged by the linker. For the same reason the loops don't call into
+// the standard library.
+
+#pragma once
+
+// The loops below keep their vector state in registers only if the steps of
+// laneGroup and laneQueue are inlined, which compilers don't always decide on
+// their own once a loop steps two of them
+#if defined(_MSC_VER)
+#  define KERNEL_INLINE __forceinline
+#elif defined(__GNUC__)
+#  define KERNEL_INLINE inline __attribute__((always_inline))
+#else
+#  define KERNEL_INLINE inline
+#endif
+
+namespace {
+
+// simd has to provide:
+//   typedef scalar (float or double), real, mask; enum { width };
+//   real load(const scalar*), broadcast(scalar), add(real, real), sub(real, real), mul(real, real)
+//   mask lessEqual(real, real), lessThan(real, real), equal(real, real)
+//   mask both(mask, mask), without(mask, mask)   a & b, a & ~b
+//   bool any(mask)
+//   int bits(mask)                     one bit per lane, lane 0 in bit 0
+//   real addWhere(real, real, mask)    adds the second operand only in set lanes
+//   real choose(mask, real, real)      first operand in set lanes, second elsewhere
+//   void store(scalar*, real)
+//
+// Iteration counts are kept in the scalar type, which is exact up to 2^24 for
+// float; selectPointRenderer() only picks float kernels below that. The scalar
+// type may also be a class like doubleDouble as long as it converts to int.
+//
+// Both loops skip points the formula can prove interior and run Brent's cycle
+// check: z is saved after 0, 1, 3, 7, ... iterations, and an orbit that lands
+// exactly on its saved value repeats forever, so it is counted as
+// maxIterations right away. Saved values start at 8, outside the bailout
+// radius, so they never match a running orbit before the first save.
+
+// Double-double lanes (MultiDouble.h) built from a double traits type, so both
+// loops run deep zooms too. Same arithmetic as the scalar doubleDouble.
+template<class simd>
+struct doubleDoubleLanes
+{
+	typedef doubleDouble scalar;
+	typedef typename simd::mask mask;
+	enum { width = simd::width };
+
+	typedef typename simd::real part;
+	struct real
+	{
+		part high;
+		part low;
+	};
+
+	static real make(part high, part low)
+	{
+		real value = {high, low};
+		return value;
+	}
+
+	static real load(const doubleDouble* p)
+	{
+		double high[width];
+		double low[width];
+		for(int lane = 0; lane < width; lane++)
+		{
+			high[lane] = p[lane].high;
+			low[lane] = p[lane].low;
+		}
+		return make(simd::load(high), simd::load(low));
+	}
+
+	static real broadcast(const doubleDouble& value) { return make(simd::broadcast(value.high), simd::broadcast(value.low)); }
+
+	static real add(real a, real b)
+	{
+		part s = simd::add(a.high, b.high);
+		part bVirtual = simd::sub(s, a.high);
+		part error = simd::add(simd::sub(a.high, simd::sub(s, bVirtual)), simd::sub(b.high, bVirtual));
+		error = simd::add(error, simd::add(a.low, b.low));
+		part high = simd::add(s, error);
+		return make(high, simd::sub(error, simd::sub(high, s)));
+	}
+
+	static real sub(real a, real b)
+	{
+		part zero = simd::broadcast(0.0);
+		return add(a, make(simd::sub(zero, b.high), simd::sub(zero, b.low)));
+	}
+
+	static real mul(real a, real b)
+	{
+		const part splitter = simd::broadcast(134217729.0);
+		part p = simd::mul(a.high, b.high);
+		part t = simd::mul(splitter, a.high);
+		part aHigh = simd::sub(t, simd::sub(t, a.high));
+		part aLow = simd::sub(a.high, aHigh);
+		t = simd::mul(splitter, b.high);
+		part bHigh = simd::sub(t, simd::sub(t, b.high));
+		part bLow = simd::sub(b.high, bHigh);
+		part error = simd::add(simd::add(simd::add(simd::sub(simd::mul(aHigh, bHigh), p), simd::mul(aHigh, bLow)), simd::mul(aLow, bHigh)), simd::mul(aLow, bLow));
+		error = simd::add(error, simd::add(simd::mul(a.high, b.low), simd::mul(a.low, b.high)));
+		part high = simd::add(p, error);
+		return make(high, simd::sub(error, simd::sub(high, p)));
+	}
+
+	// the high part of a difference has its sign and is zero only for equal values
+	static mask lessEqual(real a, real b) { return simd::lessEqual(sub(a, b).high, simd::broadcast(0.0)); }
+	static mask lessThan(real a, real b) { return simd::lessThan(sub(a, b).high, simd::broadcast(0.0)); }
+	static mask equal(real a, real b) { return simd::both(simd::equal(a.high, b.high), simd::equal(a.low, b.low)); }
+	static mask both(mask a, mask b) { return simd::both(a, b); }
+	static mask without(mask a, mask b) { return simd::without(a, b); }
+	static bool any(mask m) { return simd::any(m); }
+	static int bits(mask m) { return simd::bits(m); }
+	static real addWhere(real a, real b, mask m) { return choose(m, add(a, b), a); }
+	static real choose(mask m, real a, real b) { return make(simd::choose(m, a.high, b.high), simd::choose(m, a.low, b.low)); }
+
+	static void store(doubleDouble* p, real value)
+	{
+		double high[width];
+		double low[width];
+		simd::store(high, value.high);
+		simd::store(low, value.low);
+		for(int lane = 0; lane < width; lane++)
+			p[lane] = doubleDouble(high[lane], low[lane]);
+	}
+};
+
+// One group of width points stepped together until its slowest lane is done
+template<class simd, class formula>
+struct laneGroup
+{
+	typedef typename simd::scalar real;
+	typedef typename simd::real vector;
+	typedef typename simd::mask mask;
+	enum { width = simd::width };
+
+	vector zRe;
+	vector zIm;
+	vector cRe;
+	vector cIm;
+	vector iterationCount;
+	vector savedRe;
+	vector savedIm;
+	mask active;
+	int checkpoint;
+	int known;
+
+	void start(const real* re, const real* im, int first, int lanes, const orbitConstants& constants)
+	{
+		real laneZRe[width];
+		real laneZIm[width];
+		real laneCRe[width];
+		real laneCIm[width];
+		known = 0;
+
+		// pad a partial last group by repeating its final point; interior
+		// points start outside the bailout radius so they drop out at once
+		for(int lane = 0; lane < width; lane++)
+		{
+			int point = first + (lane < lanes ? lane : lanes - 1);
+			formula::start(re[point], im[point], constants, laneZRe[lane], laneZIm[lane], laneCRe[lane], laneCIm[lane]);
+			if(formula::interior(re[point], im[point]))
+			{
+				laneZRe[lane] = real(8);
+				known |= 1 << lane;
+			}
+		}
+
+		zRe = simd::load(laneZRe);
+		zIm = simd::load(laneZIm);
+		cRe = simd::load(laneCRe);
+		cIm = simd::load(laneCIm);
+
+		const vector zero = simd::broadcast(real(0));
+		iterationCount = zero;
+		savedRe = simd::broadcast(real(8));
+		savedIm = savedRe;
+		checkpoint = 0;
+		active = simd::lessEqual(zero, simd::broadcast(real(4)));
+	}
+
+	// Iteration n of the group; false once no lane is running
+	KERNEL_INLINE bool step(int n, const vector& four, const vector& one)
+	{
+		vector reSquared = simd::mul(zRe, zRe);
+		vector imSquared = simd::mul(zIm, zIm);
+		active = simd::both(active, simd::lessEqual(simd::add(reSquared, imSquared), four));
+		mask repeated = simd::both(active, simd::both(simd::equal(zRe, savedRe), simd::equal(zIm, savedIm)));
+		if(simd::any(repeated))
+		{
+			known |= simd::bits(repeated);
+			active = simd::without(active, repeated);
+		}
+		if(!simd::any(active))
+			return false;
+		iterationCount = simd::addWhere(iterationCount, one, active);
+
+		// all running lanes have done n iterations, so one schedule serves the group
+		if(n == checkpoint)
+		{
+			savedRe = zRe;
+			savedIm = zIm;
+			checkpoint = checkpoint * 2 + 1;
+		}
+
+		// escaped lanes keep iterating until the whole group is done, but the
+		// escape mask is sticky so their counts stay frozen
+		vector reIm = simd::mul(zRe, zIm);
+		zRe = simd::add(simd::sub(reSquared, imSquared), cRe);
+		zIm = simd::add(simd::add(reIm, reIm), cIm);
+		return true;
+	}
+
+	void finish(int* iterations, int lanes, int maxIterations, unsigned long long& usedLanes)
+	{
+		real counts[width];
+		simd::store(counts, iterationCount);
+		for(int lane = 0; lane < lanes; lane++)
+		{
+			usedLanes += int(counts[lane]);
+			iterations[lane] = (known & (1 << lane)) != 0 ? maxIterations : int(counts[lane]);
+		}
+	}
+};
+
+// Iterates groups of width points until the slowest lane of each is done
+template<class simd>
+struct blockLoop
+{
+	typedef typename simd::scalar real;
+
+	template<class formula>
+	static void run(const real* re, const real* im, int count, const orbitConstants& constants, int* iterations, laneStatistics* statistics)
+	{
+		typedef typename simd::real vector;
+		const int width = simd::width;
+
+		const vector four = simd::broadcast(real(4));
+		const vector one = simd::broadcast(real(1));
+		unsigned long long usedLanes = 0;
+		unsigned long long steps = 0;
+
+		for(int first = 0; first < count; first += width)
+		{
+			int lanes = count - first < width ? count - first : width;
+			laneGroup<simd, formula> group;
+			group.start(re, im, first, lanes, constants);
+			for(int n = 0; n < constants.maxIterations && group.step(n, four, one); n++)
+				++steps;
+			group.finish(iterations + first, lanes, constants.maxIterations, usedLanes);
+		}
+
+		if(statistics != NULL)
+		{
+			statistics->usedLanes += usedLanes;
+			statistics->totalLanes += steps * width;
+		}
+	}
+
+	// Both formulas for the same points, their groups interleaved in one loop
+	// so each hides the other's latency
+	template<class firstFormula, class secondFormula>
+	static void runPair(const real* re, const real* im, int count, const orbitConstants& constants, int* firstIterations, int* secondIterations, laneStatistics* statistics)
+	{
+		typedef typename simd::real vector;
+		const int width = simd::width;
+
+		const vector four = simd::broadcast(real(4));
+		const vector one = simd::broadcast(real(1));
+		unsigned long long usedLanes = 0;
+		unsigned long long steps = 0;
+
+		for(int first = 0; first < count; first += width)
+		{
+			int lanes = count - first < width ? count - first : width;
+			laneGroup<simd, firstFormula> firstGroup;
+			laneGroup<simd, secondFormula> secondGroup;
+			firstGroup.start(re, im, first, lanes, constants);
+			secondGroup.start(re, im, first, lanes, constants);
+
+			bool firstRunning = true;
+			bool secondRunning = true;
+			for(int n = 0; n < constants.maxIterations && (firstRunning || secondRunning); n++)
+			{
+				if(firstRunning && (firstRunning = firstGroup.step(n, four, one)))
+					++steps;
+				if(secondRunning && (secondRunning = secondGroup.step(n, four, one)))
+					++steps;
+			}
+			firstGroup.finish(firstIterations + first, lanes, constants.maxIterations, usedLanes);
+			secondGroup.finish(secondIterations + first, lanes, constants.maxIterations, usedLanes);
+		}
+
+		if(statistics != NULL)
+		{
+			statistics->usedLanes += usedLanes;
+			statistics->totalLanes += steps * width;
+		}
+	}
+};
+
+// Vector state of a laneQueue, kept apart from the queue so it can live in
+// registers while the queue itself stays in memory
+template<class simd>
+struct laneVectors
+{
+	typename simd::real zRe;
+	typename simd::real zIm;
+	typename simd::real cRe;
+	typename simd::real cIm;
+	typename simd::real iterationCount;
+	typename simd::real savedRe;
+	typename simd::real savedIm;
+	typename simd::real checkpoint;
+};
+
+// A queue of points flowing through the lanes of one vector: whenever a lane
+// finishes (escaped, cycled or reached maxIterations) its count is written out
+// and the lane restarts on the next pending point. The vector state is only
+// spilled to memory on steps where some lane finished.
+template<class simd, class formula>
+struct laneQueue
+{
+	typedef typename simd::scalar real;
+	typedef typename simd::real vector;
+	typedef typename simd::mask mask;
+	enum { width = simd::width };
+
+	const real* re;
+	const real* im;
+	int count;
+	const orbitConstants* constants;
+	int* iterations;
+
+	real laneZRe[width];
+	real laneZIm[width];
+	real laneCRe[width];
+	real laneCIm[width];
+	real laneCount[width];
+	real laneSavedRe[width];
+	real laneSavedIm[width];
+	real laneCheckpoint[width];
+	int lanePoint[width];
+
+	int next;
+	int busy;
+	unsigned long long usedLanes;
+	unsigned long long steps;
+
+	void start(const real* queueRe, const real* queueIm, int queueCount, const orbitConstants& orbit, int* queueIterations, laneVectors<simd>& state)
+	{
+		re = queueRe;
+		im = queueIm;
+		count = queueCount;
+		constants = &orbit;
+		iterations = queueIterations;
+		next = 0;
+		busy = 0;
+		usedLanes = 0;
+		steps = 0;
+
+		for(int lane = 0; lane < width; lane++)
+			refill(lane);
+		load(state);
+	}
+
+	// idle lanes sit on the fixed point z = 0, c = 0 and are ignored via busy
+	void refill(int lane)
+	{
+		laneZRe[lane] = laneZIm[lane] = laneCRe[lane] = laneCIm[lane] = laneCount[lane] = laneCheckpoint[lane] = real(0);
+		laneSavedRe[lane] = laneSavedIm[lane] = real(8);
+
+		while(next < count && formula::interior(re[next], im[next]))
+			iterations[next++] = constants->maxIterations;
+		if(next < count)
+		{
+			lanePoint[lane] = next;
+			formula::start(re[next], im[next], *constants, laneZRe[lane], laneZIm[lane], laneCRe[lane], laneCIm[lane]);
+			busy |= 1 << lane;
+			++next;
+		}
+		else
+			busy &= ~(1 << lane);
+	}
+
+	// Writes out the finished lanes of the spilled state and refills them
+	void retire(int finished, int cycled)
+	{
+		for(int lane = 0; lane < width; lane++)
+		{
+			if((finished & (1 << lane)) == 0)
+				continue;
+			usedLanes += int(laneCount[lane]);
+			iterations[lanePoint[lane]] = (cycled & (1 << lane)) != 0 ? constants->maxIterations : int(laneCount[lane]);
+			refill(lane);
+		}
+	}
+
+	KERNEL_INLINE void load(laneVectors<simd>& state) const
+	{
+		state.zRe = simd::load(laneZRe);
+		state.zIm = simd::load(laneZIm);
+		state.cRe = simd::load(laneCRe);
+		state.cIm = simd::load(laneCIm);
+		state.iterationCount = simd::load(laneCount);
+		state.savedRe = simd::load(laneSavedRe);
+		state.savedIm = simd::load(laneSavedIm);
+		state.checkpoint = simd::load(laneCheckpoint);
+	}
+
+	KERNEL_INLINE void spill(const laneVectors<simd>& state)
+	{
+		simd::store(laneZRe, state.zRe);
+		simd::store(laneZIm, state.zIm);
+		simd::store(laneCRe, state.cRe);
+		simd::store(laneCIm, state.cIm);
+		simd::store(laneCount, state.iterationCount);
+		simd::store(laneSavedRe, state.savedRe);
+		simd::store(laneSavedIm, state.savedIm);
+		simd::store(laneCheckpoint, state.checkpoint);
+	}
+
+	// One iteration of every busy lane; limit holds maxIterations
+	KERNEL_INLINE void step(laneVectors<simd>& state, const vector& four, const vector& one, const vector& limit)
+	{
+		vector reSquared = simd::mul(state.zRe, state.zRe);
+		vector imSquared = simd::mul(state.zIm, state.zIm);
+		mask active = simd::both(simd::lessEqual(simd::add(reSquared, imSquared), four), simd::lessThan(state.iterationCount, limit));
+		mask repeated = simd::both(active, simd::both(simd::equal(state.zRe, state.savedRe), simd::equal(state.zIm, state.savedIm)));
+		active = simd::without(active, repeated);
+
+		int finished = busy & ~simd::bits(active);
+		if(finished != 0)
+		{
+			spill(state);
+			retire(finished, simd::bits(repeated));
+			load(state);
+
+			// the new points need their own bailout test before counting a step
+			return;
+		}
+
+		// lanes run out of step here, so each keeps its own checkpoint
+		mask save = simd::equal(state.iterationCount, state.checkpoint);
+		state.savedRe = simd::choose(save, state.zRe, state.savedRe);
+		state.savedIm = simd::choose(save, state.zIm, state.savedIm);
+		state.checkpoint = simd::choose(save, simd::add(simd::add(state.checkpoint, state.checkpoint), one), state.checkpoint);
+
+		state.iterationCount = simd::addWhere(state.iterationCount, one, active);
+		vector reIm = simd::mul(state.zRe, state.zIm);
+		state.zRe = simd::add(simd::sub(reSquared, imSquared), state.cRe);
+		state.zIm = simd::add(simd::add(reIm, reIm), state.cIm);
+		++steps;
+	}
+
+	void report(laneStatistics* statistics) const
+	{
+		if(statistics != NULL)
+		{
+			statistics->usedLanes += usedLanes;
+			statistics->totalLanes += steps * width;
+		}
+	}
+};
+
+// Same iteration as blockLoop, but each lane moves on to the next point as
+// soon as its own point is done (laneQueue)
+template<class simd>
+struct streamingLoop
+{
+	typedef typename simd::scalar real;
+
+	template<class formula>
+	static void run(const real* re, const real* im, int count, const orbitConstants& constants, int* iterations, laneStatistics* statistics)
+	{
+		typedef typename simd::real vector;
+
+		const vector four = simd::broadcast(real(4));
+		const vector one = simd::broadcast(real(1));
+		const vector limit = simd::broadcast(real(constants.maxIterations));
+
+		laneQueue<simd, formula> queue;
+		laneVectors<simd> state;
+		queue.start(re, im, count, constants, iterations, state);
+		while(queue.busy != 0)
+			queue.step(state, four, one, limit);
+		queue.report(statistics);
+	}
+
+	// Both formulas for the same points as two queues stepped in one loop, so
+	// each hides the other's latency; the queue that drains first leaves the
+	// other to finish alone
+	template<class firstFormula, class secondFormula>
+	static void runPair(const real* re, const real* im, int count, const orbitConstants& constants, int* firstIterations, int* secondIterations, laneStatistics* statistics)
+	{
+		typedef typename simd::real vector;
+
+		const vector four = simd::broadcast(real(4));
+		const vector one = simd::broadcast(real(1));
+		const vector limit = simd::broadcast(real(constants.maxIterations));
+
+		laneQueue<simd, firstFormula> firstQueue;
+		laneQueue<simd, secondFormula> secondQueue;
+		laneVectors<simd> firstState;
+		laneVectors<simd> secondState;
+		firstQueue.start(re, im, count, constants, firstIterations, firstState);
+		secondQueue.start(re, im, count, constants, secondIterations, secondState);
+		while(firstQueue.busy != 0 && secondQueue.busy != 0)
+		{
+			firstQueue.step(firstState, four, one, limit);
+			secondQueue.step(secondState, four, one, limit);
+		}
+		while(firstQueue.busy != 0)
+			firstQueue.step(firstState, four, one, limit);
+		while(secondQueue.busy != 0)
+			secondQueue.step(secondState, four, one, limit);
+		firstQueue.report(statistics);
+		secondQueue.report(statistics);
+	}
+};
+
+}
@@ -0,0 +1,212 @@
+#include "TileScheduler.h"
+
+#include <algorithm>
+
+using namespace std;
+
+tileScheduler::tileScheduler(unsigned int threads)
+{
+	if(threads == 0)
+		threads = thread::hardware_concurrency();
+	if(threads == 0)
+		threads = 1;
+
+	workerCount = threads - 1;
+	deques = new taskDeque[workerCount + 1];
+	for(unsigned int i = 0; i <= workerCount; i++)
+	{
+		deques[i].head = 0;
+		deques[i].tail = 0;
+	}
+
+	pendingTasks = 0;
+	sleeping = 0;
+	stopping = false;
+
+	for(unsigned int i = 0; i < workerCount; i++)
+		workers.push_back(thread(&tileScheduler::workerLoop, this, i));
+}
+
+tileScheduler::~tileScheduler()
+{
+	{
+		lock_guard<mutex> guard(sleepLock);
+		stopping = true;
+	}
+	wakeup.notify_all();
+
+	for(size_t i = 0; i < workers.size(); i++)
+		workers[i].join();
+
+	delete [] deques;
+}
+
+bool tileScheduler::pushBack(unsigned int index, const tileTask& task)
+{
+	{
+		taskDeque& deque = deques[index];
+		lock_guard<mutex> guard(deque.lock);
+		if(deque.tail - deque.head == dequeCapacity)
+			return false;
+		deque.tasks[deque.tail % dequeCapacity] = task;
+		++deque.tail;
+	}
+
+	// sleepers register before they re-check pendingTasks, so either they see
+	// this task or we see them and wake one up
+	++pendingTasks;
+	if(sleeping > 0)
+	{
+		lock_guard<mutex> guard(sleepLock);
+		wakeup.notify_one();
+	}
+	return true;
+}
+
+bool tileScheduler::popBack(unsigned int index, tileTask& task)
+{
+	taskDeque& deque = deques[index];
+	lock_guard<mutex> guard(deque.lock);
+	if(deque.tail == deque.head)
+		return false;
+	--deque.tail;
+	task = deque.tasks[deque.tail % dequeCapacity];
+	--pendingTasks;
+	return true;
+}
+
+bool tileScheduler::stealFront(unsigned int index, tileTask& task)
+{
+	taskDeque& deque = deques[index];
+	lock_guard<mutex> guard(deque.lock);
+	if(deque.tail == deque.head)
+		return false;
+	task = deque.tasks[deque.head % dequeCapacity];
+	++deque.head;
+	--pendingTasks;
+	return true;
+}
+
+bool tileScheduler::findTask(unsigned int home, tileTask& task)
+{
+	if(popBack(home, task))
+		return true;
+
+	unsigned int count = workerCount + 1;
+	for(unsigned int i = 1; i < count; i++)
+		if(stealFront((home + i) % count, task))
+			return true;
+	return false;
+}
+
+void tileScheduler::execute(unsigned int home, tileTask task)
+{
+	// keep halving the range, leaving the upper halves for ourselves or thieves
+	while(task.end - task.begin > 1)
+	{
+		int middle = task.begin + (task.end - task.begin) / 2;
+		tileTask upper = {task.job, middle, task.end};
+		if(!pushBack(home, upper))
+			break;
+		task.end = middle;
+	}
+
+	tileJob* job = task.job;
+	for(int i = task.begin; i < task.end; i++)
+	{
+		tile area;
+		area.x = (i % job->tilesAcross) * job->tileSize;
+		area.y = (i / job->tilesAcross) * job->tileSize;
+		area.width = min(job->tileSize, job->width - area.x);
+		area.height = min(job->tileSize, job->height - area.y);
+		job->function(area, job->context);
+	}
+
+	// the job lives on the stack of the thread that called run(), so it must not
+	// be touched once the last tile has been counted off
+	int count = task.end - task.begin;
+	if(job->remaining.fetch_sub(count) == count)
+	{
+		lock_guard<mutex> guard(sleepLock);
+		wakeup.notify_all();
+	}
+}
+
+void tileScheduler::workerLoop(unsigned int home)
+{
+	for(;;)
+	{
+		tileTask task;
+		if(findTask(home, task))
+		{
+			execute(home, task);
+			continue;
+		}
+
+		unique_lock<mutex> lock(sleepLock);
+		++sleeping;
+		if(!stopping && pendingTasks == 0)
+			wakeup.wait(lock);
+		--sleeping;
+		if(stopping)
+			return;
+	}
+}
+
+void tileScheduler::run(int width, int height, int tileSize, tileFunction function, void* context)
+{
+	if(width <= 0 || height <= 0)
+		return;
+
+	if(tileSize <= 0)
+	{
+		// aim for at least 16 tiles per thread, but don't go below 8x8 pixels
+		tileSize = 64;
+		while(tileSize > 8 && ((width + tileSize - 1) / tileSize) * ((height + tileSize - 1) / tileSize) < int(16 * threadCount()))
+			tileSize /= 2;
+	}
+
+	tileJob job;
+	job.function = function;
+	job.context = context;
+	job.width = width;
+	job.height = height;
+	job.tileSize = tileSize;
+	job.tilesAcross = (width + tileSize - 1) / tileSize;
+	int tileCount = job.tilesAcross * ((height + tileSize - 1) / tileSize);
+	job.remaining = tileCount;
+
+	// hand every worker a contiguous slice up front so nobody starts by stealing
+	unsigned int home = workerCount;
+	unsigned int slices = min((unsigned int)tileCount, workerCount + 1);
+	unsigned int seeded = 0;
+	for(unsigned int i = 0; i < slices; i++)
+	{
+		tileTask task = {&job, int(i * (long long)tileCount / slices), int((i + 1) * (long long)tileCount / slices)};
+		if(!pushBack(i, task))
+			break;
+		seeded = i + 1;
+	}
+	if(seeded < slices)
+	{
+		tileTask rest = {&job, int(seeded * (long long)tileCount / slices), tileCount};
+		execute(home, rest);
+	}
+
+	// help out until every tile of our frame is finished
+	while(job.remaining > 0)
+	{
+		tileTask task;
+		if(findTask(home, task))
+		{
+			execute(home, task);
+			continue;
+		}
+
+		unique_lock<mutex> lock(sleepLock);
+		++sleeping;
+		if(job.remaining > 0 && pendingTasks == 0)
+			wakeup.wait(lock);
+		--sleeping;
+	}
+}
@@ -0,0 +1,94 @@
+// TileScheduler.h
+// Persistent thread pool that renders a frame as a grid of tiles.
+//
+// Escape-time cost is very uneven across a frame (interior tiles run to
+// maxIterations, exterior ones escape almost immediately), so tiles are not
+// partitioned statically. Every thread owns a deque of tile ranges: it splits
+// ranges in half, keeps working on the newest half from the back of its own
+// deque and, once that runs dry, steals the oldest (largest) range from the
+// front of someone else's.
+
+#pragma once
+
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+struct tile
+{
+	int x;
+	int y;
+	int width;
+	int height;
+};
+
+typedef void (*tileFunction)(const tile& area, void* context);
+
+class tileScheduler
+{
+public:
+	// threads counts the calling thread, which always helps with its own frame.
+	// 0 means one thread per hardware thread.
+	explicit tileScheduler(unsigned int threads = 0);
+	~tileScheduler();
+
+	unsigned int threadCount() const { return workerCount + 1; }
+
+	// Calls function once for every tile of a width x height frame and returns
+	// when all of them are done. A tileSize of 0 picks one that leaves enough
+	// tiles per thread for stealing to balance the load. Safe to call from
+	// several threads at once; their frames share the workers.
+	void run(int width, int height, int tileSize, tileFunction function, void* context);
+
+private:
+	struct tileJob
+	{
+		tileFunction function;
+		void* context;
+		int width;
+		int height;
+		int tileSize;
+		int tilesAcross;
+		std::atomic<int> remaining;
+	};
+
+	struct tileTask
+	{
+		tileJob* job;
+		int begin;
+		int end;
+	};
+
+	static const unsigned int dequeCapacity = 256;
+
+	struct taskDeque
+	{
+		std::mutex lock;
+		tileTask tasks[dequeCapacity];
+		unsigned int head;
+		unsigned int tail;
+	};
+
+	bool pushBack(unsigned int index, const tileTask& task);
+	bool popBack(unsigned int index, tileTask& task);
+	bool stealFront(unsigned int index, tileTask& task);
+	bool findTask(unsigned int home, tileTask& task);
+	void execute(unsigned int home, tileTask task);
+	void workerLoop(unsigned int home);
+
+	unsigned int workerCount;
+	// one deque per worker plus a last one shared by the threads calling run()
+	taskDeque* deques;
+	std::vector<std::thread> workers;
+
+	std::atomic<int> pendingTasks;
+	std::atomic<int> sleeping;
+	std::mutex sleepLock;
+	std::condition_variable wakeup;
+	bool stopping;
+
+	tileScheduler(const tileScheduler&);
+	tileScheduler& operator=(const tileScheduler&);
+};
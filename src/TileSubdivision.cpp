@@ -0,0 +1,170 @@
+#include "TileSubdivision.h"
+
+#include <algorithm>
+#include <vector>
+
+using namespace std;
+
+// Inclusive pixel bounds inside a tile
+struct subdivisionRect
+{
+	int left;
+	int top;
+	int right;
+	int bottom;
+};
+
+// Rectangles whose inside is at most this many pixels across are computed
+// directly; subdividing them costs more border pixels than it can save
+const int directSize = 4;
+
+// Working arrays of the functions below, one set per thread. They only grow,
+// so once a thread has had the largest tile of a frame it allocates nothing.
+struct subdivisionScratch
+{
+	vector<int> pixels;
+	vector<unsigned char> known;
+	vector<subdivisionRect> current;
+	vector<subdivisionRect> next;
+};
+
+static thread_local subdivisionScratch scratch;
+
+static int computePixels(const tile& area, const vector<int>& pixels, pixelFunction function, void* context, orbitCounts* counts)
+{
+	orbitCounts computed[pixelChunk];
+	int count = (int)pixels.size();
+
+	for(int first = 0; first < count; first += pixelChunk)
+	{
+		int points = min(pixelChunk, count - first);
+		function(area, &pixels[first], points, computed, context);
+		for(int i = 0; i < points; i++)
+			counts[pixels[first + i]] = computed[i];
+	}
+	return count;
+}
+
+static bool sameCounts(const orbitCounts& a, const orbitCounts& b)
+{
+	return a.julia == b.julia && a.mandelbrot == b.mandelbrot;
+}
+
+int bruteForceTile(const tile& area, pixelFunction function, void* context, orbitCounts* counts)
+{
+	vector<int>& pixels = scratch.pixels;
+	pixels.resize(area.width * area.height);
+	for(size_t i = 0; i < pixels.size(); i++)
+		pixels[i] = (int)i;
+	return computePixels(area, pixels, function, context, counts);
+}
+
+int completeTile(const tile& area, const unsigned char* known, pixelFunction function, void* context, orbitCounts* counts)
+{
+	vector<int>& pixels = scratch.pixels;
+	pixels.clear();
+	for(int i = 0; i < area.width * area.height; i++)
+		if(!known[i])
+			pixels.push_back(i);
+	return computePixels(area, pixels, function, context, counts);
+}
+
+int subdivideTile(const tile& area, pixelFunction function, void* context, orbitCounts* counts)
+{
+	const int width = area.width;
+	vector<unsigned char>& known = scratch.known;
+	vector<int>& pending = scratch.pixels;
+	vector<subdivisionRect>& current = scratch.current;
+	vector<subdivisionRect>& next = scratch.next;
+	int computed = 0;
+
+	subdivisionRect whole = {0, 0, width - 1, area.height - 1};
+	known.assign(width * area.height, 0);
+	current.assign(1, whole);
+
+	// one level at a time, so the borders of all rectangles of a level go to
+	// the kernels in one batch
+	while(!current.empty())
+	{
+		pending.clear();
+		for(size_t r = 0; r < current.size(); r++)
+		{
+			const subdivisionRect& rect = current[r];
+			for(int x = rect.left; x <= rect.right; x++)
+			{
+				int top = rect.top * width + x;
+				int bottom = rect.bottom * width + x;
+				if(!known[top]) { known[top] = 1; pending.push_back(top); }
+				if(!known[bottom]) { known[bottom] = 1; pending.push_back(bottom); }
+			}
+			for(int y = rect.top + 1; y < rect.bottom; y++)
+			{
+				int left = y * width + rect.left;
+				int right = y * width + rect.right;
+				if(!known[left]) { known[left] = 1; pending.push_back(left); }
+				if(!known[right]) { known[right] = 1; pending.push_back(right); }
+			}
+		}
+		computed += computePixels(area, pending, function, context, counts);
+
+		pending.clear();
+		next.clear();
+		for(size_t r = 0; r < current.size(); r++)
+		{
+			const subdivisionRect& rect = current[r];
+			if(rect.right - rect.left < 2 || rect.bottom - rect.top < 2)
+				continue;
+
+			const orbitCounts border = counts[rect.top * width + rect.left];
+			bool uniform = true;
+			for(int x = rect.left; x <= rect.right && uniform; x++)
+				uniform = sameCounts(counts[rect.top * width + x], border) && sameCounts(counts[rect.bottom * width + x], border);
+			for(int y = rect.top + 1; y < rect.bottom && uniform; y++)
+				uniform = sameCounts(counts[y * width + rect.left], border) && sameCounts(counts[y * width + rect.right], border);
+
+			if(uniform)
+			{
+				for(int y = rect.top + 1; y < rect.bottom; y++)
+				{
+					for(int x = rect.left + 1; x < rect.right; x++)
+					{
+						counts[y * width + x] = border;
+						known[y * width + x] = 1;
+					}
+				}
+			}
+			else if(rect.right - rect.left - 1 <= directSize || rect.bottom - rect.top - 1 <= directSize)
+			{
+				for(int y = rect.top + 1; y < rect.bottom; y++)
+				{
+					for(int x = rect.left + 1; x < rect.right; x++)
+					{
+						if(!known[y * width + x])
+						{
+							known[y * width + x] = 1;
+							pending.push_back(y * width + x);
+						}
+					}
+				}
+			}
+			else
+			{
+				// the quarters share the middle row and column, which become
+				// the only new border pixels of the next level
+				int middleX = (rect.left + rect.right) / 2;
+				int middleY = (rect.top + rect.bottom) / 2;
+				subdivisionRect quarters[4] = {
+					{rect.left, rect.top, middleX, middleY},
+					{middleX, rect.top, rect.right, middleY},
+					{rect.left, middleY, middleX, rect.bottom},
+					{middleX, middleY, rect.right, rect.bottom}};
+				next.insert(next.end(), quarters, quarters + 4);
+			}
+		}
+		computed += computePixels(area, pending, function, context, counts);
+
+		current.swap(next);
+	}
+
+	return computed;
+}
@@ -0,0 +1,32 @@
+// TileSubdivision.h
+// Renders one tile either pixel by pixel or by Mariani-Silver subdivision.
+//
+// Escape-time level sets are connected, so a rectangle whose whole border
+// has the same iteration counts very likely has them inside as well.
+// subdivideTile() computes borders only, fills uniform rectangles and splits
+// the others into quarters until they are too small to be worth it. Thin
+// features that cross a rectangle without touching its border are missed, so
+// the result is not guaranteed to match bruteForceTile(); FractalBatch
+// -verify renders both and counts the differing pixels.
+
+#pragma once
+
+#include "FractalCore.h"
+#include "TileScheduler.h"
+
+// Largest count a pixelFunction is called with
+const int pixelChunk = 1024;
+
+// Iterates the listed pixels of area. pixels holds count offsets into the
+// tile (y * area.width + x, relative to the tile's corner) and counts[i]
+// receives the iteration counts of pixels[i].
+typedef void (*pixelFunction)(const tile& area, const int* pixels, int count, orbitCounts* counts, void* context);
+
+// Both fill counts (area.width * area.height, row-major) and return how many
+// pixels they passed to function.
+int bruteForceTile(const tile& area, pixelFunction function, void* context, orbitCounts* counts);
+int subdivideTile(const tile& area, pixelFunction function, void* context, orbitCounts* counts);
+
+// Like bruteForceTile, but only for the pixels whose entry in known (same
+// layout as counts) is 0; the others already hold counts from another frame
+int completeTile(const tile& area, const unsigned char* known, pixelFunction function, void* context, orbitCounts* counts);
@@ -1,12 +1,14 @@
 // GLSL Fragment Shader
-// Pass-through color
+// The frame's colors, one texel per pixel
 // Jeremy Carter, Spring 2012
 
 #version 150
 
-in vec4 color;
+uniform sampler2D frameColors;
+
+in vec2 texturePosition;
 
 void main()
 {
-    gl_FragColor = color;
+    gl_FragColor = texture(frameColors, texturePosition);
 }
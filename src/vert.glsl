@@ -1,18 +1,15 @@
 // GLSL Vertex Shader
-// Pass-through position, pass-through per-primitive (uniform) color
+// A quad over the whole viewport, its corners placed from the vertex index
 // Jeremy Carter, Spring 2012
 
 #version 150
 
-in vec4 vColor;
-
-in vec4 vPosition;
-
-out vec4 color;
+// texture coordinates run down the frame, as its rows do
+out vec2 texturePosition;
 
 void main()
 {
-    gl_Position = vPosition;
-    color = vColor;
-	//color = new vec4(1,1,0,.5);
+	vec2 corner = vec2(gl_VertexID % 2, gl_VertexID / 2);
+    gl_Position = vec4(corner * 2.0 - 1.0, 0.0, 1.0);
+	texturePosition = vec2(corner.x, 1.0 - corner.y);
 }